@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//Public API of ltool_core, for embedding conversions in a long running process instead of
+//spawning the ltool CLI, which is a front end over the same library. Needs no LEADTOOLS
+//headers; SDK failures surface as tc::ltool::Error, bad settings as std::logic_error.
+namespace tc::ltool
+{
+
+class Error : public std::runtime_error
+{
+public:
+	Error(int code, std::string category, const std::string& message)
+	: std::runtime_error(message), m_code(code), m_category(std::move(category))
+	{}
+
+	//LEADTOOLS error code.
+	int code() const {
+		return m_code;
+	}
+
+	//"transient", "resource", "missing", "corrupt", "unsupported", "usage" or "unknown".
+	const std::string& category() const {
+		return m_category;
+	}
+
+private:
+	int m_code;
+	std::string m_category;
+};
+
+//Sets the LEADTOOLS license of the process. Call once before anything else.
+void initialize(const std::string& licenseFile, const std::string& developerKey);
+
+//How pages are rendered, in the syntax of the CLI options of the same names: pipeline
+//("deskew,resize=800x0"), dpi ("150,pdf=200"), pageSize ("1700x2200") and crop ("x,y,w,h").
+//Empty strings keep the defaults.
+struct RenderSettings
+{
+	std::string pipeline;
+	std::string dpi;
+	std::string pageSize;
+	std::string crop;
+};
+
+enum class Encoding
+{
+	Png,
+	Jpeg,
+	Tiff
+};
+
+//A rendered page, held decoded until it is destroyed.
+class Page
+{
+public:
+	Page(Page&&) noexcept;
+	Page& operator=(Page&&) noexcept;
+	~Page();
+
+	int width() const;
+	int height() const;
+	int bitsPerPixel() const;
+
+	//The page as a file of encoding, in memory. quality is the JPEG QFactor, 2 (best) to 255
+	//(smallest); threads only speed up PNG.
+	std::vector<uint8_t> encode(Encoding encoding, int quality = 30, size_t threads = 1);
+
+private:
+	struct Impl;
+	friend class Document;
+
+	explicit Page(std::unique_ptr<Impl> impl);
+
+	std::unique_ptr<Impl> m_impl;
+};
+
+//An input file opened for rendering page by page.
+class Document
+{
+public:
+	//Reads the header of path, including its page count.
+	static Document open(const std::filesystem::path& path, const RenderSettings& settings = {});
+
+	Document(Document&&) noexcept;
+	Document& operator=(Document&&) noexcept;
+	~Document();
+
+	int pageCount() const;
+	//Size of the first page as it will be rendered, before the pipeline.
+	int width() const;
+	int height() const;
+
+	//Decodes page (1-based) and runs it through the pipeline. Pages of one document may be
+	//rendered concurrently.
+	Page render(int page) const;
+
+private:
+	struct Impl;
+
+	explicit Document(std::unique_ptr<Impl> impl);
+
+	std::unique_ptr<Impl> m_impl;
+};
+
+//Runs a completion where the caller wants it, typically by posting it to the caller's event
+//loop. An empty executor runs completions right on the thread that did the work.
+using Executor = std::function<void(std::function<void()>)>;
+
+//Completion of an asynchronous call: error is null when it succeeded, result is empty otherwise.
+template<typename T>
+using Callback = std::function<void(std::exception_ptr error, T result)>;
+
+//Document, render and encode calls for event loop servers: the blocking SDK work runs on
+//threads of the renderer's own, the completions through the caller's executor. Calls never
+//block, so any number can be in flight over a few threads; pending() is there for backpressure.
+class AsyncRenderer
+{
+public:
+	explicit AsyncRenderer(size_t threads);
+
+	AsyncRenderer(const AsyncRenderer&) = delete;
+	AsyncRenderer& operator=(const AsyncRenderer&) = delete;
+
+	//Waits for the calls in flight; by then their completions are with the executors.
+	~AsyncRenderer();
+
+	//Calls queued or running.
+	size_t pending() const;
+
+	void open(const std::filesystem::path& path, const RenderSettings& settings, Executor resume, Callback<std::shared_ptr<const Document>> done);
+
+	void render(std::shared_ptr<const Document> document, int page, Executor resume, Callback<std::shared_ptr<Page>> done);
+
+	//Encoding may flip the page's rows in place: one encode of a page at a time.
+	void encode(std::shared_ptr<Page> page, Encoding encoding, int quality, Executor resume, Callback<std::vector<uint8_t>> done);
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> m_impl;
+};
+
+struct ConverterSettings
+{
+	//Conversions run at once.
+	size_t threads = 1;
+	//Conversions waiting for a thread before submit() blocks.
+	size_t queue = 16;
+	RenderSettings render;
+	//"png" writes the first page; "tif" and "pdf" every page into one file; "svg" every
+	//page as a vector file of its own.
+	std::string output = "png";
+	//Encode PNG with the built-in parallel encoder instead of the SDK's.
+	bool builtinPng = false;
+	//Largest PNG written, 0 for no limit: larger pages are reduced to a palette or shrunk
+	//until they fit, from the one decode. For "png" output only.
+	uint64_t maxBytes = 0;
+	//Pages of one document rendered concurrently, by threads idle otherwise.
+	size_t pageThreads = 1;
+	//Pins the threads to cores across the NUMA nodes, with a queue per node.
+	bool affinity = false;
+};
+
+//File to file conversions on a pool of its own, the way `ltool batch` runs them.
+class Converter
+{
+public:
+	explicit Converter(const ConverterSettings& settings);
+
+	Converter(const Converter&) = delete;
+	Converter& operator=(const Converter&) = delete;
+
+	//Waits for the conversions submitted.
+	~Converter();
+
+	//Extension of the files written, dot included.
+	std::string extension() const;
+
+	//Queues the conversion of input to output; the future throws Error when it fails.
+	//Blocks while settings.queue conversions are waiting.
+	std::future<void> submit(const std::filesystem::path& input, const std::filesystem::path& output);
+
+	//submit() for event loops: never blocks, queueing past settings.queue if need be. done gets
+	//the exception the conversion failed with, or null, and runs through resume.
+	void submit(const std::filesystem::path& input, const std::filesystem::path& output, Executor resume, std::function<void(std::exception_ptr)> done);
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> m_impl;
+};
+
+} //namespace tc::ltool
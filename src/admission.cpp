@@ -0,0 +1,95 @@
+#include "admission.h"
+
+#include <algorithm>
+
+#include "stats.h"
+
+namespace tc::ltool
+{
+
+namespace
+{
+
+//Decoder state and the encoder's working copy come on top of the page itself.
+constexpr double workingSetFactor = 2.0;
+
+} //namespace
+
+AdmissionController::AdmissionController(uint64_t memoryBudget)
+: m_limit(memoryBudget), m_budget(memoryBudget)
+{
+	publish();
+}
+
+uint64_t AdmissionController::rawPageBytes(const FILEINFO& fileInfo) {
+	const uint64_t bitsPerPixel = fileInfo.BitsPerPixel > 0 ? fileInfo.BitsPerPixel : 24;
+	const uint64_t width = std::max(fileInfo.Width, 1);
+	const uint64_t height = std::max(fileInfo.Height, 1);
+	return (width * bitsPerPixel + 7) / 8 * height;
+}
+
+uint64_t AdmissionController::estimate(const FILEINFO& fileInfo, unsigned pages) const {
+	std::lock_guard lock(m_mutex);
+	return static_cast<uint64_t>(rawPageBytes(fileInfo) * std::max(pages, 1u) * m_correction * workingSetFactor);
+}
+
+AdmissionController::Ticket AdmissionController::admit(uint64_t bytes) {
+	std::unique_lock lock(m_mutex);
+	const auto ticket = m_nextTicket++;
+	m_changed.wait(lock, [&] {
+		return m_serving == ticket && (m_running == 0 || m_inUse + bytes <= m_budget);
+	});
+	++m_serving;
+	m_inUse += bytes;
+	++m_running;
+	publish();
+	lock.unlock();
+	//The next in line may fit as well.
+	m_changed.notify_all();
+	return Ticket(*this, bytes);
+}
+
+void AdmissionController::release(uint64_t bytes) {
+	{
+		std::lock_guard lock(m_mutex);
+		m_inUse -= bytes;
+		--m_running;
+		publish();
+	}
+	m_changed.notify_all();
+}
+
+void AdmissionController::observe(uint64_t estimatedPageBytes, uint64_t actualPageBytes) {
+	if(!estimatedPageBytes || !actualPageBytes) {
+		return;
+	}
+	std::lock_guard lock(m_mutex);
+	const double ratio = static_cast<double>(actualPageBytes) / estimatedPageBytes;
+	m_correction = std::clamp(0.8 * m_correction + 0.2 * ratio, 0.25, 16.0);
+}
+
+void AdmissionController::onOutOfMemory() {
+	std::lock_guard lock(m_mutex);
+	m_budget = std::max(m_limit / 8, m_budget / 2);
+	publish();
+}
+
+void AdmissionController::onSuccess() {
+	{
+		std::lock_guard lock(m_mutex);
+		if(m_budget == m_limit) {
+			return;
+		}
+		m_budget = std::min(m_limit, m_budget + m_limit / 32);
+		publish();
+	}
+	m_changed.notify_all();
+}
+
+void AdmissionController::publish() {
+	auto& stats = Stats::get();
+	stats.memoryAdmitted.set(static_cast<int64_t>(m_inUse));
+	stats.memoryBudget.set(static_cast<int64_t>(m_budget));
+}
+
+} //namespace tc::ltool
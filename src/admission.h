@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+//Admits jobs against a memory budget, so many small inputs run side by side while large
+//ones are spaced out. Costs are estimated from L_FileInfo and corrected by what decoding
+//actually allocated; out-of-memory failures shrink the budget, successes grow it back.
+//Jobs are admitted in arrival order, so a large job is never starved by small ones.
+class AdmissionController
+{
+public:
+	explicit AdmissionController(uint64_t memoryBudget);
+
+	//Releases the admitted bytes when destroyed.
+	class Ticket
+	{
+	public:
+		Ticket(AdmissionController& controller, uint64_t bytes)
+		: m_controller(&controller), m_bytes(bytes)
+		{}
+		Ticket(Ticket&& other) noexcept
+		: m_controller(std::exchange(other.m_controller, nullptr)), m_bytes(other.m_bytes)
+		{}
+		Ticket(const Ticket&) = delete;
+		Ticket& operator=(const Ticket&) = delete;
+		Ticket& operator=(Ticket&&) = delete;
+		~Ticket() {
+			if(m_controller) {
+				m_controller->release(m_bytes);
+			}
+		}
+
+	private:
+		AdmissionController* m_controller;
+		uint64_t m_bytes;
+	};
+
+	//Bytes a job rendering pages of this file is expected to hold at its peak.
+	uint64_t estimate(const FILEINFO& fileInfo, unsigned pages = 1) const;
+
+	//Blocks until the job fits the budget. A job larger than the whole budget runs alone.
+	Ticket admit(uint64_t bytes);
+
+	//Feeds back the decoded size of a page whose raw estimate was estimatedPageBytes.
+	void observe(uint64_t estimatedPageBytes, uint64_t actualPageBytes);
+	void onOutOfMemory();
+	void onSuccess();
+
+	static uint64_t rawPageBytes(const FILEINFO& fileInfo);
+
+private:
+	void release(uint64_t bytes);
+	void publish();
+
+	const uint64_t m_limit;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_changed;
+	uint64_t m_budget;
+	uint64_t m_inUse = 0;
+	size_t m_running = 0;
+	uint64_t m_nextTicket = 0;
+	uint64_t m_serving = 0;
+	//Decoded size over the FILEINFO estimate; documents often render at another DPI
+	//than their header suggests.
+	double m_correction = 1.0;
+};
+
+} //namespace tc::ltool
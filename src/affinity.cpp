@@ -0,0 +1,179 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tc
+{
+
+namespace
+{
+
+std::string readLine(const std::filesystem::path& file) {
+	std::ifstream in(file);
+	std::string line;
+	std::getline(in, line);
+	return line;
+}
+
+//"0-3,8,10-11" as a list.
+std::vector<int> parseCpuList(const std::string& text) {
+	std::vector<int> cpus;
+	std::istringstream stream(text);
+	std::string range;
+	while(std::getline(stream, range, ',')) {
+		try {
+			const auto dash = range.find('-');
+			const int first = std::stoi(range.substr(0, dash));
+			const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for(int cpu = first; cpu <= last; ++cpu) {
+				cpus.push_back(cpu);
+			}
+		}
+		catch(const std::exception&) {
+		}
+	}
+	return cpus;
+}
+
+struct Node
+{
+	int id;
+	std::vector<int> cpus;
+};
+
+#ifdef __linux__
+
+std::vector<int> allowedCpus() {
+	std::vector<int> cpus;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if(CPU_ISSET(cpu, &set)) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+	return cpus;
+}
+
+//First CPU of each core before the hyper-threading siblings.
+void coresFirst(std::vector<int>& cpus) {
+	std::stable_partition(cpus.begin(), cpus.end(), [](int cpu) {
+		const auto siblings = parseCpuList(readLine("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+		return siblings.empty() || siblings.front() == cpu;
+	});
+}
+
+std::vector<Node> detectNodes() {
+	const auto allowed = allowedCpus();
+	std::map<int, Node> nodes;
+	std::error_code ec;
+	for(std::filesystem::directory_iterator it("/sys/devices/system/node", ec), end; !ec && it != end; it.increment(ec)) {
+		const auto name = it->path().filename().string();
+		if(name.size() <= 4 || name.compare(0, 4, "node") != 0 || !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+			continue;
+		}
+		const int id = std::stoi(name.substr(4));
+		Node node{id, {}};
+		for(int cpu : parseCpuList(readLine(it->path() / "cpulist"))) {
+			if(std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+				node.cpus.push_back(cpu);
+			}
+		}
+		if(!node.cpus.empty()) {
+			nodes.emplace(id, std::move(node));
+		}
+	}
+	std::vector<Node> result;
+	for(auto& [id, node] : nodes) {
+		result.push_back(std::move(node));
+	}
+	if(result.empty() && !allowed.empty()) {
+		result.push_back({0, allowed});
+	}
+	for(auto& node : result) {
+		coresFirst(node.cpus);
+	}
+	return result;
+}
+
+#else
+
+std::vector<Node> detectNodes() {
+	return {};
+}
+
+#endif
+
+} //namespace
+
+std::vector<CpuSlot> placeWorkers(size_t threads) {
+	const auto nodes = detectNodes();
+	std::vector<CpuSlot> slots;
+	for(size_t i = 0; i < threads; ++i) {
+		if(nodes.empty()) {
+			slots.push_back({});
+			continue;
+		}
+		const auto& node = nodes[i % nodes.size()];
+		slots.push_back({node.cpus[(i / nodes.size()) % node.cpus.size()], node.id});
+	}
+	return slots;
+}
+
+void pinCurrentThread(const CpuSlot& slot) {
+#ifdef __linux__
+	if(slot.cpu < 0 || slot.cpu >= CPU_SETSIZE) {
+		return;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(slot.cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	//Preferred rather than bound: a full node falls back to remote memory instead of failing.
+	constexpr size_t bitsPerWord = sizeof(unsigned long) * 8;
+	unsigned long nodes[16] = {};
+	if(slot.node >= 0 && static_cast<size_t>(slot.node) < sizeof(nodes) * 8) {
+		nodes[slot.node / bitsPerWord] |= 1UL << (slot.node % bitsPerWord);
+		syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes, sizeof(nodes) * 8);
+	}
+#else
+	(void)slot;
+#endif
+}
+
+std::unique_ptr<WorkStealingPool> makePinnedPool(size_t threads, size_t capacity) {
+	auto slots = placeWorkers(threads ? threads : 1);
+	return std::make_unique<WorkStealingPool>(nodeShards(slots), capacity, [slots](size_t worker) {
+		pinCurrentThread(slots[worker]);
+	});
+}
+
+std::vector<size_t> nodeShards(const std::vector<CpuSlot>& slots) {
+	std::map<int, size_t> shards;
+	for(const auto& slot : slots) {
+		shards.emplace(slot.node, shards.size());
+	}
+	std::vector<size_t> result;
+	for(const auto& slot : slots) {
+		result.push_back(shards[slot.node]);
+	}
+	return result;
+}
+
+} //namespace tc
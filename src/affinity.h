@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "work_stealing.h"
+
+namespace tc
+{
+
+//A CPU a worker thread is pinned to and the NUMA node it belongs to.
+struct CpuSlot
+{
+	int cpu = -1;
+	int node = 0;
+};
+
+//One slot per worker for threads workers over the CPUs the process may run on: nodes take
+//turns, so the workers are spread over every socket, and within a node each worker gets a
+//physical core of its own before hyper-threading siblings are used. Nodes come from
+///sys/devices/system/node; without it every CPU counts as node 0.
+std::vector<CpuSlot> placeWorkers(size_t threads);
+
+//Pins the calling thread to slot.cpu and has the memory it allocates from now on (bitmaps the
+//SDK decodes, encoder buffers) preferably taken from slot.node. Failures are ignored: the
+//thread then merely runs unpinned.
+void pinCurrentThread(const CpuSlot& slot);
+
+//Dense shard index per slot, one shard per NUMA node used, for WorkStealingPool.
+std::vector<size_t> nodeShards(const std::vector<CpuSlot>& slots);
+
+//A WorkStealingPool with its threads workers pinned as placeWorkers() places them and a
+//queue per NUMA node, so jobs are decoded and encoded on the node holding their memory.
+std::unique_ptr<WorkStealingPool> makePinnedPool(size_t threads, size_t capacity);
+
+} //namespace tc
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+
+namespace tc
+{
+
+//Scratch memory of the job running on the calling thread: a monotonic arena that hands out
+//memory by bumping a pointer and drops all of it at once when the thread's outermost Scope
+//ends. The buffer grows to fit the largest job seen, so once warmed up jobs take nothing
+//from the global heap for their scratch. Outside any Scope scratch comes from the heap.
+class JobArena
+{
+public:
+	//Marks a job, or a task of one, on the calling thread. Nested scopes share the outermost.
+	class Scope
+	{
+	public:
+		Scope() {
+			++arena().m_depth;
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		~Scope() {
+			auto& self = arena();
+			if(--self.m_depth == 0) {
+				self.reset();
+			}
+		}
+	};
+
+	//Where scratch of the calling thread goes right now.
+	static std::pmr::memory_resource* resource() {
+		auto& self = arena();
+		return self.m_depth ? &*self.m_resource : std::pmr::new_delete_resource();
+	}
+
+private:
+	//The heap behind the arena, counting what the buffer could not hold.
+	class Overflow : public std::pmr::memory_resource
+	{
+	public:
+		size_t bytes = 0;
+
+	private:
+		void* do_allocate(size_t size, size_t alignment) override {
+			bytes += size;
+			return std::pmr::new_delete_resource()->allocate(size, alignment);
+		}
+
+		void do_deallocate(void* p, size_t size, size_t alignment) override {
+			std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+	};
+
+	JobArena() {
+		allocate();
+	}
+
+	static JobArena& arena() {
+		thread_local JobArena t_arena;
+		return t_arena;
+	}
+
+	void allocate() {
+		m_resource.reset();
+		m_buffer = std::make_unique<std::byte[]>(m_size);
+		m_overflow.bytes = 0;
+		m_resource.emplace(m_buffer.get(), m_size, &m_overflow);
+	}
+
+	//Without overflow this is just rewinding the pointer.
+	void reset() {
+		if(m_overflow.bytes) {
+			m_size += m_overflow.bytes;
+			allocate();
+		}
+		else {
+			m_resource->release();
+		}
+	}
+
+	size_t m_size = 16 << 10;
+	size_t m_depth = 0;
+	std::unique_ptr<std::byte[]> m_buffer;
+	Overflow m_overflow;
+	std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+};
+
+//Returns scratch memory to the resource it came from; a no-op for the arena.
+struct ScratchDeleter
+{
+	std::pmr::memory_resource* resource;
+	size_t size;
+
+	void operator()(char* p) const {
+		resource->deallocate(p, size, 1);
+	}
+};
+
+using ScratchChars = std::unique_ptr<char[], ScratchDeleter>;
+
+//NUL terminated copy of text in scratch memory, for SDK calls taking a non-const string.
+//Like strdup(), but free of heap allocations inside a JobArena::Scope.
+inline ScratchChars scratchCopy(std::string_view text) {
+	auto* resource = JobArena::resource();
+	const size_t size = text.size() + 1;
+	auto* copy = static_cast<char*>(resource->allocate(size, 1));
+	std::memcpy(copy, text.data(), text.size());
+	copy[text.size()] = 0;
+	return ScratchChars(copy, ScratchDeleter{resource, size});
+}
+
+inline ScratchChars scratchPath(const std::filesystem::path& path) {
+#ifdef _WIN32
+	return scratchCopy(path.string());
+#else
+	//The native form is already narrow, no temporary string needed.
+	return scratchCopy(path.native());
+#endif
+}
+
+} //namespace tc
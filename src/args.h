@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tc
+{
+
+//Splits the command line into positional arguments and "--name [value]" options.
+//Options listed in flags take no value, every other option consumes the next argument
+//(or the part after '=').
+class Args
+{
+public:
+	Args(int argc, char** argv, std::set<std::string> flags, std::set<std::string> valued) {
+		for(int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if(arg.size() <= 2 || arg.compare(0, 2, "--") != 0) {
+				m_positional.push_back(std::move(arg));
+				continue;
+			}
+			std::string name = arg.substr(2);
+			std::optional<std::string> value;
+			if(auto eq = name.find('='); eq != std::string::npos) {
+				value = name.substr(eq + 1);
+				name.erase(eq);
+			}
+			if(flags.count(name)) {
+				if(value) {
+					throw std::logic_error("Option --" + name + " takes no value");
+				}
+				m_options[name] = "";
+			}
+			else if(valued.count(name)) {
+				if(!value) {
+					if(++i == argc) {
+						throw std::logic_error("Option --" + name + " requires a value");
+					}
+					value = argv[i];
+				}
+				m_options[name] = *value;
+			}
+			else {
+				throw std::logic_error("Unknown option --" + name);
+			}
+		}
+	}
+
+	const std::vector<std::string>& positional() const {
+		return m_positional;
+	}
+
+	bool has(const std::string& name) const {
+		return m_options.count(name) != 0;
+	}
+
+	std::optional<std::string> value(const std::string& name) const {
+		if(auto it = m_options.find(name); it != m_options.end()) {
+			return it->second;
+		}
+		return std::nullopt;
+	}
+
+	template<typename T>
+	T get(const std::string& name, T defaultValue) const {
+		auto str = value(name);
+		if(!str) {
+			return defaultValue;
+		}
+		std::istringstream stream(*str);
+		T result{};
+		if(!(stream >> result) || !stream.eof()) {
+			throw std::logic_error("Invalid value for --" + name + ": " + *str);
+		}
+		return result;
+	}
+
+	//Accepts a plain byte count or one with a K, M or G suffix (powers of 1024).
+	uint64_t getBytes(const std::string& name, uint64_t defaultValue) const {
+		auto str = value(name);
+		if(!str) {
+			return defaultValue;
+		}
+		size_t end = 0;
+		uint64_t result = 0;
+		try {
+			result = std::stoull(*str, &end);
+		}
+		catch(const std::exception&) {
+			throw std::logic_error("Invalid value for --" + name + ": " + *str);
+		}
+		const std::string suffix = str->substr(end);
+		if(suffix == "K" || suffix == "k") {
+			result <<= 10;
+		}
+		else if(suffix == "M" || suffix == "m") {
+			result <<= 20;
+		}
+		else if(suffix == "G" || suffix == "g") {
+			result <<= 30;
+		}
+		else if(!suffix.empty()) {
+			throw std::logic_error("Invalid value for --" + name + ": " + *str);
+		}
+		return result;
+	}
+
+private:
+	std::vector<std::string> m_positional;
+	std::map<std::string, std::string> m_options;
+};
+
+} //namespace tc
@@ -0,0 +1,115 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "affinity.h"
+#include "manifest.h"
+#include "metrics.h"
+#include "prefetch.h"
+#include "stats.h"
+#include "work_stealing.h"
+
+namespace tc::ltool
+{
+
+using namespace std::filesystem;
+
+BatchSummary batch(const path& inDir, const path& outDir, const BatchOptions& options) {
+	std::vector<path> inputs;
+	for(const auto& entry : directory_iterator(inDir)) {
+		auto name = entry.path().filename().string();
+		if(entry.is_regular_file() && name.front() != '.') {
+			inputs.push_back(entry.path());
+		}
+	}
+	std::sort(inputs.begin(), inputs.end());
+	create_directories(outDir);
+
+	std::optional<Manifest> manifest;
+	size_t unchanged = 0;
+	if(!options.state.empty()) {
+		manifest.emplace(options.state);
+		//SVG exports are named per page, so their output is not checked.
+		auto outputFor = [&](const path& input) {
+			return options.convert.svg ? path() : outputPathFor(input, outDir, options.convert);
+		};
+		auto stale = manifest->stale(inputs, optionsFingerprint(options.convert), outputFor, options.threads);
+		unchanged = inputs.size() - stale.size();
+		inputs = std::move(stale);
+	}
+
+	std::optional<Prefetcher> prefetcher;
+	if(options.prefetch) {
+		//A few readers are enough to keep slow storage busy.
+		prefetcher.emplace(inputs, options.prefetch, options.prefetchBytes, std::min<size_t>(options.prefetch, 4));
+	}
+
+	std::optional<metrics::Server> metricsServer;
+	if(options.metricsPort) {
+		metricsServer.emplace(options.metricsPort);
+	}
+	std::atomic<size_t> succeeded{0};
+	std::atomic<size_t> failed{0};
+	std::atomic<size_t> cancelled{0};
+	std::atomic<bool> aborted{false};
+	std::optional<AdmissionController> admission;
+	JobSettings settings{options.convert, options.policy};
+	if(options.maxMemory) {
+		settings.admission = &admission.emplace(options.maxMemory);
+	}
+	{
+		//Jobs of multi-page documents split into page tasks the idle workers steal, so the
+		//largest document no longer bounds the batch.
+		auto pool = options.affinity ? makePinnedPool(options.threads, options.threads * 2) : std::make_unique<WorkStealingPool>(options.threads, options.threads * 2);
+		auto& stats = Stats::get();
+		stats.workers.set(options.threads);
+		for(size_t index = 0; index < inputs.size(); ++index) {
+			stats.queueDepth.add();
+			pool->submit([&, index] {
+				const auto& input = inputs[index];
+				stats.queueDepth.add(-1);
+				if(aborted) {
+					++cancelled;
+					if(prefetcher) {
+						prefetcher->finished(index);
+					}
+					return;
+				}
+				if(prefetcher) {
+					prefetcher->started(index);
+				}
+				stats.workersBusy.add();
+				const auto status = runJob(input, outputPathFor(input, outDir, options.convert), settings);
+				stats.workersBusy.add(-1);
+				if(prefetcher) {
+					prefetcher->finished(index);
+				}
+				switch(status) {
+				case JobStatus::Succeeded:
+					if(manifest) {
+						manifest->converted(input);
+					}
+					++succeeded;
+					break;
+				case JobStatus::Aborted:
+					aborted = true;
+					[[fallthrough]];
+				case JobStatus::Skipped:
+					++failed;
+					break;
+				}
+			});
+		}
+		pool->wait();
+	}
+	if(manifest) {
+		manifest->save();
+	}
+	return {succeeded, failed, cancelled, unchanged, aborted};
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "job.h"
+
+namespace tc::ltool
+{
+
+struct BatchOptions
+{
+	size_t threads = 1;
+	//Serves the metrics registry on 127.0.0.1 while the batch runs when non-zero.
+	uint16_t metricsPort = 0;
+	ConvertOptions convert;
+	ErrorPolicy policy;
+	//Estimated memory of the jobs converted at once; 0 admits on thread count alone.
+	uint64_t maxMemory = 0;
+	//Manifest of an earlier run; when set only new or changed inputs are converted.
+	std::filesystem::path state;
+	//Inputs read ahead of the decoders (see Prefetcher); 0 disables.
+	size_t prefetch = 0;
+	//Bytes read ahead and not converted yet.
+	uint64_t prefetchBytes = 256 << 20;
+	//Pins workers to cores across the NUMA nodes, with a job queue per node.
+	bool affinity = false;
+};
+
+struct BatchSummary
+{
+	size_t succeeded = 0;
+	size_t failed = 0;
+	//Jobs never started because an earlier one aborted the run.
+	size_t cancelled = 0;
+	//Inputs the state manifest found up to date.
+	size_t unchanged = 0;
+	bool aborted = false;
+};
+
+//Converts every file of inDir (names starting with '.' excepted) into outDir.
+BatchSummary batch(const std::filesystem::path& inDir, const std::filesystem::path& outDir, const BatchOptions& options);
+
+} //namespace tc::ltool
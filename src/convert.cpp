@@ -0,0 +1,351 @@
+#include "convert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <ltsvg.h>
+
+#include "arena.h"
+#include "page_writer.h"
+#include "size_budget.h"
+#include "stats.h"
+#include "trace.h"
+#include "work_stealing.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+void countWritten(const std::filesystem::path& output) {
+	std::error_code ec;
+	if(auto size = std::filesystem::file_size(output, ec); !ec) {
+		Stats::get().bytesWritten.add(size);
+	}
+}
+
+//The part of region inside the page size fileInfo reports. Throws std::logic_error when
+//nothing is left: the crop is a bad argument, not a damaged input.
+Region clampToPage(Region region, const FILEINFO& fileInfo) {
+	const auto requested = region;
+	if(fileInfo.Width > 0 && fileInfo.Height > 0) {
+		region.width = std::min(region.width, fileInfo.Width - region.x);
+		region.height = std::min(region.height, fileInfo.Height - region.y);
+	}
+	if(region.width <= 0 || region.height <= 0) {
+		std::ostringstream message;
+		message << "Crop " << requested.x << ',' << requested.y << ',' << requested.width << ',' << requested.height
+			<< " lies outside the " << fileInfo.Width << 'x' << fileInfo.Height << " page";
+		throw std::logic_error(message.str());
+	}
+	return region;
+}
+
+} //namespace
+
+Bitmap renderPage(const std::filesystem::path& input, FILEINFO& fileInfo, int page, const ConvertOptions& options, uint64_t& decodedBytes) {
+	auto& stats = Stats::get();
+	Bitmap bitmap;
+	LOADFILEOPTION loadOpt{};
+	call(L_GetDefaultLoadFileOption, &loadOpt, sizeof(LOADFILEOPTION));
+	loadOpt.PageNumber = page;
+	options.rasterize.apply(input);
+	if(options.crop) {
+		const auto region = clampToPage(*options.crop, fileInfo);
+		metrics::ScopedTimer timer(stats.loadSeconds);
+		trace::Span span("load_page_region", page);
+		call(L_LoadFileTile, tc::scratchPath(input).get(), bitmap.get(), sizeof(BITMAPHANDLE), region.x, region.y,
+			region.width, region.height, 0, ORDER_BGRORGRAY, LOADFILE_ALLOCATE | LOADFILE_STORE, nullptr, nullptr, &loadOpt, &fileInfo);
+	}
+	else {
+		metrics::ScopedTimer timer(stats.loadSeconds);
+		trace::Span span("load_page", page);
+		call(L_LoadBitmap, tc::scratchPath(input).get(), bitmap.get(), sizeof(BITMAPHANDLE), 0, 0, &loadOpt, &fileInfo);
+	}
+	decodedBytes = static_cast<uint64_t>(bitmap->BytesPerLine) * bitmap->Height;
+	if(!options.pipeline.empty()) {
+		metrics::ScopedTimer timer(stats.transformSeconds);
+		trace::Span span("transform", page);
+		options.pipeline.apply(*bitmap.get());
+	}
+	return bitmap;
+}
+
+namespace
+{
+
+PageResult describePage(const std::filesystem::path& input, int page, const std::filesystem::path& output, Bitmap& bitmap, const ConvertOptions& options) {
+	PageResult result{input, page, output, std::nullopt, std::nullopt};
+	if(options.phash) {
+		trace::Span span("phash", page);
+		result.hash = pageHash(*bitmap.get());
+	}
+	return result;
+}
+
+uint64_t convertRaster(const std::filesystem::path& input, const std::filesystem::path& output, FILEINFO& fileInfo, const ConvertOptions& options) {
+	auto& stats = Stats::get();
+	uint64_t decodedBytes = 0;
+	auto bitmap = renderPage(input, fileInfo, 1, options, decodedBytes);
+	//Copies the paths, so only when someone looks at it.
+	auto result = options.report || options.duplicates ? describePage(input, 1, output, bitmap, options) : PageResult{};
+	if(options.duplicates && result.hash) {
+		result.duplicateOf = options.duplicates->findOrInsert(*result.hash, output);
+	}
+	if(result.duplicateOf) {
+		result.output.clear();
+		stats.duplicatePages.add();
+	}
+	else {
+		try {
+			metrics::ScopedTimer timer(stats.saveSeconds);
+			//L_SaveBitmap encodes and writes in one call.
+			trace::Span span("encode_write", 1);
+			if(options.maxBytes) {
+				writeFile(output, fitPng(*bitmap.get(), options.maxBytes, options.png, options.pageThreads).bytes);
+			}
+			else if(options.png.builtin && canWritePng(*bitmap)) {
+				writePng(*bitmap.get(), output, options.png, options.pageThreads);
+			}
+			else {
+				call(L_SaveBitmap, tc::scratchPath(output).get(), bitmap.get(), FILE_PNG, 0, 0, nullptr);
+			}
+		}
+		catch(...) {
+			//Later pages like this one must not point at an output that does not exist.
+			if(options.duplicates && result.hash) {
+				options.duplicates->remove(*result.hash, output);
+			}
+			throw;
+		}
+		stats.pages.add();
+		countWritten(output);
+	}
+	if(options.report) {
+		options.report->record(result);
+	}
+	return decodedBytes;
+}
+
+L_INT containerFormat(Container container) {
+	switch(container) {
+	case Container::Tiff: return FILE_TIFLZW;
+	case Container::Pdf: return FILE_RAS_PDF;
+	case Container::None: break;
+	}
+	throw std::logic_error("No multi-page container selected");
+}
+
+//Renders pages on up to options.pageThreads threads and appends them to one file in order.
+//In a batch the extra renderers are tasks idle workers steal.
+uint64_t convertMultipage(const std::filesystem::path& input, const std::filesystem::path& output, const FILEINFO& fileInfo, const ConvertOptions& options) {
+	const int totalPages = std::max(fileInfo.TotalPages, 1);
+	OrderedPageWriter writer(output, containerFormat(options.container), options.pageWindow);
+	std::atomic<int> nextPage{1};
+	std::atomic<uint64_t> largestPage{0};
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto render = [&] {
+		try {
+			//Each thread hands L_LoadBitmap its own copy, the SDK may write to it.
+			auto threadFileInfo = fileInfo;
+			for(;;) {
+				//Before claiming a page, so other renderers never wait for this one meanwhile.
+				if(options.preemptionPoint) {
+					options.preemptionPoint();
+				}
+				const int page = nextPage++;
+				if(page > totalPages) {
+					break;
+				}
+				writer.waitForSlot(page);
+				//Page tasks may run on workers outside any job, or stolen by one running another.
+				JobArena::Scope scratch;
+				trace::FileScope traceFile(input);
+				uint64_t decodedBytes = 0;
+				auto bitmap = renderPage(input, threadFileInfo, page, options, decodedBytes);
+				for(auto largest = largestPage.load(); decodedBytes > largest && !largestPage.compare_exchange_weak(largest, decodedBytes);) {
+				}
+				if(options.report) {
+					options.report->record(describePage(input, page, output, bitmap, options));
+				}
+				writer.submit(page, std::move(bitmap));
+			}
+		}
+		catch(...) {
+			std::lock_guard lock(errorMutex);
+			if(!error) {
+				error = std::current_exception();
+			}
+			writer.fail(error);
+		}
+	};
+	runConcurrently(std::clamp<size_t>(options.pageThreads, 1, totalPages), render);
+	if(error) {
+		//A truncated document would pass for a complete one.
+		std::error_code ec;
+		std::filesystem::remove(output, ec);
+		std::rethrow_exception(error);
+	}
+	countWritten(output);
+	return largestPage;
+}
+
+//Vector formats (PDF, Office, ...) go page by page through L_LoadSvg, nothing is rasterized.
+//Every page is a file of its own, so pages are exported on up to options.pageThreads threads in any order.
+void convertSvg(const std::filesystem::path& input, const std::filesystem::path& output, const FILEINFO& fileInfo, const ConvertOptions& options) {
+	auto& stats = Stats::get();
+	auto inputName = tc::scratchPath(input);
+	LOADFILEOPTION defaultLoadOpt{};
+	call(L_GetDefaultLoadFileOption, &defaultLoadOpt, sizeof(LOADFILEOPTION));
+	L_BOOL canLoad = false;
+	call(L_CanLoadSvg, inputName.get(), &canLoad, &defaultLoadOpt);
+	if(!canLoad) {
+		throw LeadToolsException(ERROR_FEATURE_NOT_SUPPORTED);
+	}
+	const int totalPages = std::max(fileInfo.TotalPages, 1);
+	std::atomic<int> nextPage{1};
+	std::atomic<bool> failed{false};
+	auto exportPages = [&] {
+		auto loadOpt = defaultLoadOpt;
+		auto threadInputName = tc::scratchPath(input);
+		for(;;) {
+			if(options.preemptionPoint) {
+				options.preemptionPoint();
+			}
+			const int page = nextPage++;
+			if(page > totalPages || failed) {
+				break;
+			}
+			try {
+				JobArena::Scope scratch;
+				trace::FileScope traceFile(input);
+				loadOpt.PageNumber = page;
+				LOADSVGOPTIONS svgOpt{};
+				svgOpt.uStructSize = sizeof(LOADSVGOPTIONS);
+				{
+					metrics::ScopedTimer timer(stats.loadSeconds);
+					trace::Span span("load_svg_page", page);
+					call(L_LoadSvg, threadInputName.get(), &svgOpt, &loadOpt);
+				}
+				auto document = tc::makeUnique(svgOpt.SvgHandle, L_SvgFreeNode);
+				const auto pageOutput = pageOutputPath(output, page, totalPages);
+				{
+					metrics::ScopedTimer timer(stats.saveSeconds);
+					trace::Span span("encode_write", page);
+					call(L_SvgSaveDocument, tc::scratchPath(pageOutput).get(), document.get(), nullptr);
+				}
+				stats.pages.add();
+				countWritten(pageOutput);
+			}
+			catch(...) {
+				failed = true;
+				throw;
+			}
+		}
+	};
+	runConcurrently(std::clamp<size_t>(options.pageThreads, 1, totalPages), exportPages);
+}
+
+} //namespace
+
+Region parseRegion(const std::string& text) {
+	std::istringstream stream(text);
+	Region region;
+	char comma[3] = {};
+	if(!(stream >> region.x >> comma[0] >> region.y >> comma[1] >> region.width >> comma[2] >> region.height) || !stream.eof()
+		|| comma[0] != ',' || comma[1] != ',' || comma[2] != ',' || region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0) {
+		throw std::logic_error("Invalid region: " + text);
+	}
+	return region;
+}
+
+const char* outputExtension(const ConvertOptions& options) {
+	switch(options.container) {
+	case Container::Tiff: return ".tif";
+	case Container::Pdf: return ".pdf";
+	case Container::None: break;
+	}
+	return options.svg ? ".svg" : ".png";
+}
+
+unsigned pagesInMemory(const FILEINFO& fileInfo, const ConvertOptions& options) {
+	if(options.container == Container::None || options.svg) {
+		return 1;
+	}
+	return static_cast<unsigned>(std::min<size_t>(std::max(fileInfo.TotalPages, 1), options.pageThreads + options.pageWindow));
+}
+
+std::filesystem::path pageOutputPath(const std::filesystem::path& output, int page, int totalPages) {
+	if(totalPages <= 1) {
+		return output;
+	}
+	const auto width = std::to_string(totalPages).size();
+	std::ostringstream name;
+	name << output.stem().string() << '-' << std::setw(width) << std::setfill('0') << page << output.extension().string();
+	return output.parent_path() / name.str();
+}
+
+std::string optionsFingerprint(const ConvertOptions& options) {
+	std::ostringstream text;
+	text << "svg=" << options.svg << ";container=" << static_cast<int>(options.container) << ";pipeline=" << options.pipeline.spec();
+	if(options.crop) {
+		const auto& crop = *options.crop;
+		text << ";crop=" << crop.x << ',' << crop.y << ',' << crop.width << ',' << crop.height;
+	}
+	if(!options.rasterize.empty()) {
+		text << ";rasterize=" << options.rasterize.spec();
+	}
+	if(options.png.builtin) {
+		text << ";png=" << static_cast<int>(options.png.filter) << ',' << options.png.level;
+	}
+	if(options.maxBytes) {
+		text << ";max-bytes=" << options.maxBytes;
+	}
+	return text.str();
+}
+
+FILEINFO probe(const std::filesystem::path& input, const RasterizePolicy& rasterize, bool countPages, int page) {
+	metrics::ScopedTimer timer(Stats::get().fileInfoSeconds);
+	trace::Span span("file_info");
+	rasterize.apply(input);
+	LOADFILEOPTION loadOpt{};
+	call(L_GetDefaultLoadFileOption, &loadOpt, sizeof(LOADFILEOPTION));
+	loadOpt.PageNumber = page;
+	FILEINFO fileInfo{};
+	call(L_FileInfo, tc::scratchPath(input).get(), &fileInfo, sizeof(FILEINFO), countPages ? FILEINFO_TOTALPAGES : 0, &loadOpt);
+	return fileInfo;
+}
+
+FILEINFO probe(const std::filesystem::path& input, const ConvertOptions& options) {
+	return probe(input, options.rasterize, options.svg || options.container != Container::None);
+}
+
+uint64_t convert(const std::filesystem::path& input, const std::filesystem::path& output, FILEINFO& fileInfo, const ConvertOptions& options) {
+	uint64_t decodedBytes = 0;
+	if(options.svg) {
+		convertSvg(input, output, fileInfo, options);
+	}
+	else if(options.container != Container::None) {
+		decodedBytes = convertMultipage(input, output, fileInfo, options);
+	}
+	else {
+		decodedBytes = convertRaster(input, output, fileInfo, options);
+	}
+	std::error_code ec;
+	if(auto size = std::filesystem::file_size(input, ec); !ec) {
+		Stats::get().bytesRead.add(size);
+	}
+	return decodedBytes;
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include "leadtools.h"
+#include "phash.h"
+#include "pipeline.h"
+#include "png_writer.h"
+#include "rasterize.h"
+#include "report.h"
+
+namespace tc::ltool
+{
+
+enum class Container
+{
+	None,
+	//Multi-page TIFF, LZW compressed
+	Tiff,
+	//Image-only PDF
+	Pdf
+};
+
+//Rectangle of a page in pixels, top-left origin.
+struct Region
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+//Parses "x,y,w,h". Throws std::logic_error for anything else.
+Region parseRegion(const std::string& text);
+
+struct ConvertOptions
+{
+	//Export every page as SVG through the SDK's vector path instead of rasterizing.
+	bool svg = false;
+	//Applied to each rasterized page before it is encoded.
+	Pipeline pipeline;
+	//Resolution and page size document pages are rasterized at.
+	RasterizePolicy rasterize;
+	//Only this part of every page is decoded, through L_LoadFileTile: JPEG and TIFF decoding
+	//stops after the last row of the region. Not for svg.
+	std::optional<Region> crop;
+	//Appends every page to one file of this format instead of writing the first page as PNG.
+	Container container = Container::None;
+	//Pages of one document rendered concurrently for a container.
+	size_t pageThreads = 1;
+	//Rendered pages allowed to wait for an earlier page to be written.
+	size_t pageWindow = 4;
+	//Encoder of PNG output; the built-in one deflates on pageThreads threads.
+	PngOptions png;
+	//Largest PNG written, 0 for no limit: a larger page is reduced to a palette or shrunk
+	//with fitPng(). Not for svg or containers.
+	uint64_t maxBytes = 0;
+	//Computes pageHash() of every rendered page for the report.
+	bool phash = false;
+	//Gets a PageResult for every rendered page when set.
+	Report* report = nullptr;
+	//When set, a PNG page near an earlier output is reported as its duplicate and not written.
+	//Pages of a container are always kept. Needs phash.
+	DuplicateIndex* duplicates = nullptr;
+	//Called between the pages of a multi-page conversion; may run more urgent jobs inline.
+	std::function<void()> preemptionPoint;
+};
+
+//Extension of the files convert() writes with these options, dot included.
+const char* outputExtension(const ConvertOptions& options);
+
+//Pages of the document held decoded at once by convert().
+unsigned pagesInMemory(const FILEINFO& fileInfo, const ConvertOptions& options);
+
+//Where page of a totalPages document goes: output itself for single page documents,
+//otherwise output with a zero padded page number appended to the stem.
+std::filesystem::path pageOutputPath(const std::filesystem::path& output, int page, int totalPages);
+
+//The options that shape the output, as text: inputs converted under another fingerprint are stale.
+std::string optionsFingerprint(const ConvertOptions& options);
+
+//Reads the header of input, including its page count unless countPages is false: counting can
+//take a pass over the whole file. Page sizes of documents are the ones rasterize renders them at;
+//the size returned is that of page (1-based).
+FILEINFO probe(const std::filesystem::path& input, const RasterizePolicy& rasterize = {}, bool countPages = true, int page = 1);
+
+//probe() reading what convert() needs with options; first page conversions skip the page count.
+FILEINFO probe(const std::filesystem::path& input, const ConvertOptions& options);
+
+//Decodes page (1-based) of input, cropped and rasterized as options say, and runs it through
+//options.pipeline. decodedBytes gets the size of the decoded bitmap. The SDK may update fileInfo.
+leadtools::Bitmap renderPage(const std::filesystem::path& input, FILEINFO& fileInfo, int page, const ConvertOptions& options, uint64_t& decodedBytes);
+
+//Renders the first page of input, runs it through options.pipeline and saves it as a PNG
+//to output. With options.container every page is rendered and appended to output, with
+//options.svg every page is saved as SVG. Returns the size of the largest page decoded to a bitmap.
+//Expects the license to be already set for the process.
+uint64_t convert(const std::filesystem::path& input, const std::filesystem::path& output, FILEINFO& fileInfo, const ConvertOptions& options = {});
+
+inline uint64_t convert(const std::filesystem::path& input, const std::filesystem::path& output, const ConvertOptions& options = {}) {
+	auto fileInfo = probe(input, options);
+	return convert(input, output, fileInfo, options);
+}
+
+} //namespace tc::ltool
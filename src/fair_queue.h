@@ -0,0 +1,122 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace tc
+{
+
+enum class Priority
+{
+	High,
+	Normal,
+	Low
+};
+
+inline const char* toString(Priority priority) {
+	switch(priority) {
+	case Priority::High: return "high";
+	case Priority::Normal: return "normal";
+	case Priority::Low: return "low";
+	}
+	return "unknown";
+}
+
+//Job queue ordered by priority class first; within a class tenants take turns, each tenant's
+//own jobs in arrival order. A tenant dropping a thousand files thus delays another tenant's
+//next job by one job, not by a thousand.
+template<typename T>
+class FairQueue
+{
+public:
+	void push(Priority priority, const std::string& tenant, T item) {
+		std::lock_guard lock(m_mutex);
+		auto& level = m_levels[index(priority)];
+		auto& items = level.items[tenant];
+		if(items.empty()) {
+			level.turns.push_back(tenant);
+		}
+		items.push_back(std::move(item));
+		++m_size;
+		m_ready.notify_one();
+	}
+
+	//Blocks until a job is waiting; empty once close() was called.
+	std::optional<T> pop() {
+		std::unique_lock lock(m_mutex);
+		m_ready.wait(lock, [this] { return m_closed || m_size > 0; });
+		if(m_closed) {
+			return std::nullopt;
+		}
+		return popBefore(levelCount);
+	}
+
+	//Next job of a class strictly more urgent than priority, if one is waiting.
+	std::optional<T> popMoreUrgentThan(Priority priority) {
+		std::lock_guard lock(m_mutex);
+		return popBefore(index(priority));
+	}
+
+	//Wakes every pop() and makes them return empty; waiting jobs are dropped.
+	void close() {
+		std::lock_guard lock(m_mutex);
+		m_closed = true;
+		m_ready.notify_all();
+	}
+
+	size_t size() const {
+		std::lock_guard lock(m_mutex);
+		return m_size;
+	}
+
+private:
+	static constexpr size_t levelCount = 3;
+
+	struct Level
+	{
+		std::unordered_map<std::string, std::deque<T>> items;
+		//Tenants with waiting jobs, next to serve in front.
+		std::deque<std::string> turns;
+	};
+
+	static size_t index(Priority priority) {
+		return static_cast<size_t>(priority);
+	}
+
+	//Expects m_mutex held.
+	std::optional<T> popBefore(size_t end) {
+		for(size_t i = 0; i < end; ++i) {
+			auto& level = m_levels[i];
+			if(level.turns.empty()) {
+				continue;
+			}
+			auto tenant = std::move(level.turns.front());
+			level.turns.pop_front();
+			auto found = level.items.find(tenant);
+			T item = std::move(found->second.front());
+			found->second.pop_front();
+			if(found->second.empty()) {
+				level.items.erase(found);
+			}
+			else {
+				level.turns.push_back(std::move(tenant));
+			}
+			--m_size;
+			return item;
+		}
+		return std::nullopt;
+	}
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_ready;
+	Level m_levels[levelCount];
+	size_t m_size = 0;
+	bool m_closed = false;
+};
+
+} //namespace tc
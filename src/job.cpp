@@ -0,0 +1,76 @@
+#include "job.h"
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+std::filesystem::path outputPathFor(const std::filesystem::path& input, const std::filesystem::path& outDir, const ConvertOptions& options) {
+	return outDir / std::filesystem::path(input.filename()).replace_extension(outputExtension(options));
+}
+
+JobStatus runJob(const std::filesystem::path& input, const std::filesystem::path& output, const JobSettings& settings) {
+	auto& stats = Stats::get();
+	//Scratch of every attempt is dropped at once when the job ends.
+	JobArena::Scope scratch;
+	trace::FileScope traceFile(input);
+	trace::Span span("job");
+	const auto& policy = settings.policy;
+	auto* admission = settings.admission;
+	auto backoff = policy.backoff;
+	for(unsigned attempt = 0;; ++attempt) {
+		try {
+			auto fileInfo = probe(input, settings.convert);
+			std::optional<AdmissionController::Ticket> ticket;
+			if(admission) {
+				ticket.emplace(admission->admit(admission->estimate(fileInfo, pagesInMemory(fileInfo, settings.convert))));
+			}
+			auto decodedBytes = convert(input, output, fileInfo, settings.convert);
+			if(admission) {
+				admission->observe(AdmissionController::rawPageBytes(fileInfo), decodedBytes);
+				admission->onSuccess();
+			}
+			stats.jobsSucceeded.add();
+			return JobStatus::Succeeded;
+		}
+		catch(const LeadToolsException& e) {
+			auto category = e.category();
+			stats.recordError(e.code(), toString(category));
+			if(admission && category == ErrorCategory::Resource) {
+				admission->onOutOfMemory();
+			}
+			auto action = policy.actionFor(category);
+			if(action == ErrorAction::Retry && attempt < policy.retries) {
+				stats.retries.add();
+				std::this_thread::sleep_for(backoff);
+				backoff *= 2;
+				continue;
+			}
+			std::cerr << input.string() << ": " << e.what() << " (" << toString(category) << ")" << std::endl;
+			stats.jobsFailed.add();
+			return action == ErrorAction::Abort ? JobStatus::Aborted : JobStatus::Skipped;
+		}
+		catch(const std::logic_error& e) {
+			//Bad options, such as a crop off the page: the next job fails the same way.
+			std::cerr << input.string() << ": " << e.what() << " (usage)" << std::endl;
+			stats.jobsFailed.add();
+			return JobStatus::Aborted;
+		}
+		catch(const std::exception& e) {
+			std::cerr << input.string() << ": " << e.what() << std::endl;
+			stats.jobsFailed.add();
+			return JobStatus::Skipped;
+		}
+	}
+}
+
+} //namespace tc::ltool
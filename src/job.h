@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+#include "admission.h"
+#include "convert.h"
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+enum class ErrorAction
+{
+	Skip,
+	Retry,
+	Abort
+};
+
+//Decides per error category whether a failed job is retried, given up on, or stops the run.
+struct ErrorPolicy
+{
+	unsigned retries = 2;
+	//Doubles after every attempt.
+	std::chrono::milliseconds backoff{200};
+
+	ErrorAction actionFor(leadtools::ErrorCategory category) const {
+		using leadtools::ErrorCategory;
+		switch(category) {
+		case ErrorCategory::Transient:
+		case ErrorCategory::Resource:
+			return ErrorAction::Retry;
+		case ErrorCategory::Usage:
+			return ErrorAction::Abort;
+		default:
+			return ErrorAction::Skip;
+		}
+	}
+};
+
+enum class JobStatus
+{
+	Succeeded,
+	Skipped,
+	//Failed with an error that will fail every other job too.
+	Aborted
+};
+
+struct JobSettings
+{
+	ConvertOptions convert;
+	ErrorPolicy policy;
+	//Optional; when set the job waits until its estimated memory fits the budget before decoding.
+	AdmissionController* admission = nullptr;
+};
+
+std::filesystem::path outputPathFor(const std::filesystem::path& input, const std::filesystem::path& outDir, const ConvertOptions& options);
+
+//Converts input to output applying settings.policy to failures, which are reported on stderr
+//and counted in Stats.
+JobStatus runJob(const std::filesystem::path& input, const std::filesystem::path& output, const JobSettings& settings);
+
+} //namespace tc::ltool
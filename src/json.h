@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace tc
+{
+
+//Writes text as a quoted JSON string; control characters other than newline become spaces.
+inline void writeJsonString(std::ostream& out, const std::string& text) {
+	out << '"';
+	for(char c : text) {
+		switch(c) {
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20) {
+				out << ' ';
+			}
+			else {
+				out << c;
+			}
+		}
+	}
+	out << '"';
+}
+
+} //namespace tc
@@ -0,0 +1,413 @@
+#include "kernels.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TC_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace tc::kernels
+{
+
+namespace scalar
+{
+
+void swapRedBlue(uint8_t* pixels, size_t count) {
+	for(size_t i = 0; i < count; ++i, pixels += 3) {
+		auto first = pixels[0];
+		pixels[0] = pixels[2];
+		pixels[2] = first;
+	}
+}
+
+void bgrToGray(const uint8_t* bgr, uint8_t* gray, size_t count) {
+	for(size_t i = 0; i < count; ++i, bgr += 3) {
+		gray[i] = static_cast<uint8_t>((29 * bgr[0] + 150 * bgr[1] + 77 * bgr[2] + 128) >> 8);
+	}
+}
+
+void boxDownscale2x(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels) {
+	const size_t step = static_cast<size_t>(channels);
+	for(size_t x = 0; x < width; ++x) {
+		for(size_t c = 0; c < step; ++c) {
+			const size_t left = 2 * x * step + c;
+			const size_t right = left + step;
+			out[x * step + c] = static_cast<uint8_t>((row0[left] + row0[right] + row1[left] + row1[right] + 2) >> 2);
+		}
+	}
+}
+
+} //namespace scalar
+
+namespace
+{
+
+#ifdef TC_KERNELS_X86
+
+//pshufb mask gathering channel (0 B, 1 G, 2 R) of 16 BGR pixels from the 16 byte block
+//block (0..2) of their 48 bytes; positions fed by other blocks are zeroed.
+constexpr std::array<int8_t, 16> deinterleaveMask(int channel, int block) {
+	std::array<int8_t, 16> mask{};
+	for(int pos = 0; pos < 16; ++pos) {
+		const int byte = 3 * pos + channel - 16 * block;
+		mask[pos] = byte >= 0 && byte < 16 ? static_cast<int8_t>(byte) : static_cast<int8_t>(-128);
+	}
+	return mask;
+}
+
+alignas(16) constexpr std::array<std::array<std::array<int8_t, 16>, 3>, 3> deinterleaveMasks = {{
+	{{deinterleaveMask(0, 0), deinterleaveMask(0, 1), deinterleaveMask(0, 2)}},
+	{{deinterleaveMask(1, 0), deinterleaveMask(1, 1), deinterleaveMask(1, 2)}},
+	{{deinterleaveMask(2, 0), deinterleaveMask(2, 1), deinterleaveMask(2, 2)}},
+}};
+
+__attribute__((target("ssse3")))
+inline __m128i gatherChannel(__m128i a, __m128i b, __m128i c, int channel) {
+	const auto* masks = deinterleaveMasks[channel].data();
+	return _mm_or_si128(
+		_mm_or_si128(
+			_mm_shuffle_epi8(a, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[0].data()))),
+			_mm_shuffle_epi8(b, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[1].data())))
+		),
+		_mm_shuffle_epi8(c, _mm_load_si128(reinterpret_cast<const __m128i*>(masks[2].data())))
+	);
+}
+
+__attribute__((target("ssse3")))
+inline void deinterleave16(const uint8_t* bgr, __m128i& blue, __m128i& green, __m128i& red) {
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr));
+	const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 16));
+	const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 32));
+	blue = gatherChannel(a, b, c, 0);
+	green = gatherChannel(a, b, c, 1);
+	red = gatherChannel(a, b, c, 2);
+}
+
+//--- SSSE3 ---
+
+__attribute__((target("ssse3")))
+void swapRedBlueSsse3(uint8_t* pixels, size_t count) {
+	const size_t bytes = count * 3;
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+	size_t i = 0;
+	//Five pixels per step; the 16th byte is written back unchanged and redone by the next step.
+	for(; i + 16 <= bytes; i += 15) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_shuffle_epi8(v, mask));
+	}
+	scalar::swapRedBlue(pixels + i, (bytes - i) / 3);
+}
+
+__attribute__((target("ssse3")))
+inline __m128i luma8(__m128i blue, __m128i green, __m128i red, __m128i zero) {
+	const __m128i wb = _mm_set1_epi16(29);
+	const __m128i wg = _mm_set1_epi16(150);
+	const __m128i wr = _mm_set1_epi16(77);
+	const __m128i round = _mm_set1_epi16(128);
+	//The weights add up to 256, so the sums fit unsigned 16 bits.
+	auto half = [&](__m128i b, __m128i g, __m128i r) {
+		const __m128i sum = _mm_add_epi16(
+			_mm_add_epi16(_mm_mullo_epi16(b, wb), _mm_mullo_epi16(g, wg)),
+			_mm_add_epi16(_mm_mullo_epi16(r, wr), round)
+		);
+		return _mm_srli_epi16(sum, 8);
+	};
+	const __m128i low = half(_mm_unpacklo_epi8(blue, zero), _mm_unpacklo_epi8(green, zero), _mm_unpacklo_epi8(red, zero));
+	const __m128i high = half(_mm_unpackhi_epi8(blue, zero), _mm_unpackhi_epi8(green, zero), _mm_unpackhi_epi8(red, zero));
+	return _mm_packus_epi16(low, high);
+}
+
+__attribute__((target("ssse3")))
+void bgrToGraySsse3(const uint8_t* bgr, uint8_t* gray, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 16 <= count; i += 16) {
+		__m128i blue, green, red;
+		deinterleave16(bgr + 3 * i, blue, green, red);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(gray + i), luma8(blue, green, red, zero));
+	}
+	scalar::bgrToGray(bgr + 3 * i, gray + i, count - i);
+}
+
+//Rounded averages of the 2x2 blocks of the two BGR pixel pairs at top and bottom, as the
+//first six 16-bit lanes.
+__attribute__((target("ssse3")))
+inline __m128i averagePairs3(const uint8_t* top, const uint8_t* bottom, __m128i left, __m128i right) {
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top));
+	const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom));
+	const __m128i sum = _mm_add_epi16(
+		_mm_add_epi16(_mm_shuffle_epi8(a, left), _mm_shuffle_epi8(a, right)),
+		_mm_add_epi16(_mm_add_epi16(_mm_shuffle_epi8(b, left), _mm_shuffle_epi8(b, right)), _mm_set1_epi16(2))
+	);
+	return _mm_srli_epi16(sum, 2);
+}
+
+//Even and odd pixels of the eight 32-bit pixels at row.
+__attribute__((target("ssse3")))
+inline void splitPixels4(const uint8_t* row, __m128i& even, __m128i& odd) {
+	const __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row)));
+	const __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 16)));
+	even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+__attribute__((target("ssse3")))
+void boxDownscale2xSsse3(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels) {
+	size_t x = 0;
+	if(channels == 1) {
+		const __m128i ones = _mm_set1_epi8(1);
+		const __m128i two = _mm_set1_epi16(2);
+		for(; x + 8 <= width; x += 8) {
+			const __m128i top = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x)), ones);
+			const __m128i bottom = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x)), ones);
+			const __m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top, bottom), two), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(average, average));
+		}
+	}
+	else if(channels == 3) {
+		//Pairs of BGR pixels of 12 bytes as 16-bit lanes: the left pixels and the right ones.
+		const __m128i left = _mm_setr_epi8(0, -128, 1, -128, 2, -128, 6, -128, 7, -128, 8, -128, -128, -128, -128, -128);
+		const __m128i right = _mm_setr_epi8(3, -128, 4, -128, 5, -128, 9, -128, 10, -128, 11, -128, -128, -128, -128, -128);
+		const __m128i compact = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -128, -128, -128, -128);
+		//Four pixels per step from two 16 byte loads 12 bytes apart; the last one ends 28 bytes
+		//into the 6 * width of a row.
+		for(; x + 5 <= width; x += 4) {
+			const __m128i first = averagePairs3(row0 + 6 * x, row1 + 6 * x, left, right);
+			const __m128i second = averagePairs3(row0 + 6 * x + 12, row1 + 6 * x + 12, left, right);
+			const __m128i packed = _mm_shuffle_epi8(_mm_packus_epi16(first, second), compact);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 3 * x), packed);
+			const uint32_t tail = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(packed, 8)));
+			std::memcpy(out + 3 * x + 8, &tail, sizeof(tail));
+		}
+	}
+	else if(channels == 4) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		for(; x + 4 <= width; x += 4) {
+			__m128i even0, odd0, even1, odd1;
+			splitPixels4(row0 + 8 * x, even0, odd0);
+			splitPixels4(row1 + 8 * x, even1, odd1);
+			const __m128i low = _mm_srli_epi16(_mm_add_epi16(
+				_mm_add_epi16(_mm_unpacklo_epi8(even0, zero), _mm_unpacklo_epi8(odd0, zero)),
+				_mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(even1, zero), _mm_unpacklo_epi8(odd1, zero)), two)
+			), 2);
+			const __m128i high = _mm_srli_epi16(_mm_add_epi16(
+				_mm_add_epi16(_mm_unpackhi_epi8(even0, zero), _mm_unpackhi_epi8(odd0, zero)),
+				_mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(even1, zero), _mm_unpackhi_epi8(odd1, zero)), two)
+			), 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x), _mm_packus_epi16(low, high));
+		}
+	}
+	const size_t step = static_cast<size_t>(channels);
+	scalar::boxDownscale2x(row0 + 2 * x * step, row1 + 2 * x * step, out + x * step, width - x, channels);
+}
+
+//--- AVX2 ---
+
+__attribute__((target("avx2")))
+void swapRedBlueAvx2(uint8_t* pixels, size_t count) {
+	const size_t bytes = count * 3;
+	const __m256i mask = _mm256_setr_epi8(
+		2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15,
+		2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15
+	);
+	size_t i = 0;
+	//pshufb stays within 128-bit lanes, so each lane takes five pixels of its own.
+	for(; i + 31 <= bytes; i += 30) {
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 15));
+		const __m256i v = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), mask);
+		//Low lane first: its last byte is stale and overwritten by the high lane.
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm256_castsi256_si128(v));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i + 15), _mm256_extracti128_si256(v, 1));
+	}
+	swapRedBlueSsse3(pixels + i, (bytes - i) / 3);
+}
+
+__attribute__((target("avx2")))
+inline __m128i luma16(__m128i blue, __m128i green, __m128i red) {
+	const __m256i sum = _mm256_add_epi16(
+		_mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_cvtepu8_epi16(blue), _mm256_set1_epi16(29)),
+			_mm256_mullo_epi16(_mm256_cvtepu8_epi16(green), _mm256_set1_epi16(150))
+		),
+		_mm256_add_epi16(_mm256_mullo_epi16(_mm256_cvtepu8_epi16(red), _mm256_set1_epi16(77)), _mm256_set1_epi16(128))
+	);
+	const __m256i shifted = _mm256_srli_epi16(sum, 8);
+	return _mm_packus_epi16(_mm256_castsi256_si128(shifted), _mm256_extracti128_si256(shifted, 1));
+}
+
+__attribute__((target("avx2")))
+void bgrToGrayAvx2(const uint8_t* bgr, uint8_t* gray, size_t count) {
+	size_t i = 0;
+	for(; i + 16 <= count; i += 16) {
+		__m128i blue, green, red;
+		deinterleave16(bgr + 3 * i, blue, green, red);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(gray + i), luma16(blue, green, red));
+	}
+	scalar::bgrToGray(bgr + 3 * i, gray + i, count - i);
+}
+
+//Even and odd pixels of the sixteen 32-bit pixels at row, in the order of shuffle_ps.
+__attribute__((target("avx2")))
+inline void splitPixels8(const uint8_t* row, __m256i& even, __m256i& odd) {
+	const __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row)));
+	const __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 32)));
+	even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	odd = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+//Rounded average of four vectors of bytes, as 16-bit lanes.
+__attribute__((target("avx2")))
+inline __m256i average4(__m128i a, __m128i b, __m128i c, __m128i d) {
+	const __m256i sum = _mm256_add_epi16(
+		_mm256_add_epi16(_mm256_cvtepu8_epi16(a), _mm256_cvtepu8_epi16(b)),
+		_mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(c), _mm256_cvtepu8_epi16(d)), _mm256_set1_epi16(2))
+	);
+	return _mm256_srli_epi16(sum, 2);
+}
+
+__attribute__((target("avx2")))
+void boxDownscale2xAvx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels) {
+	size_t x = 0;
+	if(channels == 1) {
+		const __m256i ones = _mm256_set1_epi8(1);
+		const __m256i two = _mm256_set1_epi16(2);
+		for(; x + 16 <= width; x += 16) {
+			const __m256i top = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2 * x)), ones);
+			const __m256i bottom = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2 * x)), ones);
+			const __m256i average = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(top, bottom), two), 2);
+			//packus works per lane; gather the two useful quadwords.
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(average, average), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(packed));
+		}
+	}
+	else if(channels == 4) {
+		for(; x + 8 <= width; x += 8) {
+			//shuffle_ps stays within 128-bit lanes: even pixels come out as 0 2 8 10 | 4 6 12 14,
+			//and the per lane pack below undoes that order.
+			__m256i even0, odd0, even1, odd1;
+			splitPixels8(row0 + 8 * x, even0, odd0);
+			splitPixels8(row1 + 8 * x, even1, odd1);
+			const __m256i low = average4(_mm256_castsi256_si128(even0), _mm256_castsi256_si128(odd0), _mm256_castsi256_si128(even1), _mm256_castsi256_si128(odd1));
+			const __m256i high = average4(_mm256_extracti128_si256(even0, 1), _mm256_extracti128_si256(odd0, 1), _mm256_extracti128_si256(even1, 1), _mm256_extracti128_si256(odd1, 1));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x), _mm256_packus_epi16(low, high));
+		}
+	}
+	const size_t step = static_cast<size_t>(channels);
+	boxDownscale2xSsse3(row0 + 2 * x * step, row1 + 2 * x * step, out + x * step, width - x, channels);
+}
+
+//--- AVX-512 ---
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+void swapRedBlueAvx512(uint8_t* pixels, size_t count) {
+	const size_t bytes = count * 3;
+	alignas(64) static const std::array<uint8_t, 64> order = [] {
+		std::array<uint8_t, 64> result{};
+		for(uint8_t pixel = 0; pixel < 21; ++pixel) {
+			result[3 * pixel] = 3 * pixel + 2;
+			result[3 * pixel + 1] = 3 * pixel + 1;
+			result[3 * pixel + 2] = 3 * pixel;
+		}
+		result[63] = 63;
+		return result;
+	}();
+	const __m512i index = _mm512_load_si512(order.data());
+	//21 pixels per step; masked loads and stores never touch the 64th byte.
+	const __mmask64 mask = (__mmask64(1) << 63) - 1;
+	size_t i = 0;
+	for(; i + 63 <= bytes; i += 63) {
+		const __m512i v = _mm512_maskz_loadu_epi8(mask, pixels + i);
+		_mm512_mask_storeu_epi8(pixels + i, mask, _mm512_permutexvar_epi8(index, v));
+	}
+	swapRedBlueAvx2(pixels + i, (bytes - i) / 3);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i widen(__m128i low, __m128i high) {
+	return _mm512_cvtepu8_epi16(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void bgrToGrayAvx512(const uint8_t* bgr, uint8_t* gray, size_t count) {
+	size_t i = 0;
+	for(; i + 32 <= count; i += 32) {
+		__m128i blue0, green0, red0, blue1, green1, red1;
+		deinterleave16(bgr + 3 * i, blue0, green0, red0);
+		deinterleave16(bgr + 3 * i + 48, blue1, green1, red1);
+		const __m512i sum = _mm512_add_epi16(
+			_mm512_add_epi16(
+				_mm512_mullo_epi16(widen(blue0, blue1), _mm512_set1_epi16(29)),
+				_mm512_mullo_epi16(widen(green0, green1), _mm512_set1_epi16(150))
+			),
+			_mm512_add_epi16(_mm512_mullo_epi16(widen(red0, red1), _mm512_set1_epi16(77)), _mm512_set1_epi16(128))
+		);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + i), _mm512_cvtepi16_epi8(_mm512_srli_epi16(sum, 8)));
+	}
+	bgrToGrayAvx2(bgr + 3 * i, gray + i, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void boxDownscale2xAvx512(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels) {
+	size_t x = 0;
+	if(channels == 1) {
+		const __m512i ones = _mm512_set1_epi8(1);
+		const __m512i two = _mm512_set1_epi16(2);
+		for(; x + 32 <= width; x += 32) {
+			const __m512i top = _mm512_maddubs_epi16(_mm512_loadu_si512(row0 + 2 * x), ones);
+			const __m512i bottom = _mm512_maddubs_epi16(_mm512_loadu_si512(row1 + 2 * x), ones);
+			const __m512i average = _mm512_srli_epi16(_mm512_add_epi16(_mm512_add_epi16(top, bottom), two), 2);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm512_cvtepi16_epi8(average));
+		}
+	}
+	const size_t step = static_cast<size_t>(channels);
+	boxDownscale2xAvx2(row0 + 2 * x * step, row1 + 2 * x * step, out + x * step, width - x, channels);
+}
+
+#endif //TC_KERNELS_X86
+
+const Kernels& dispatch() {
+	static const Kernels selected = supported().front();
+	return selected;
+}
+
+} //namespace
+
+std::vector<Kernels> supported() {
+	std::vector<Kernels> result;
+#ifdef TC_KERNELS_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi")) {
+		result.push_back({"avx512", swapRedBlueAvx512, bgrToGrayAvx512, boxDownscale2xAvx512});
+	}
+	if(__builtin_cpu_supports("avx2")) {
+		result.push_back({"avx2", swapRedBlueAvx2, bgrToGrayAvx2, boxDownscale2xAvx2});
+	}
+	if(__builtin_cpu_supports("ssse3")) {
+		result.push_back({"ssse3", swapRedBlueSsse3, bgrToGraySsse3, boxDownscale2xSsse3});
+	}
+#endif
+	result.push_back({"scalar", scalar::swapRedBlue, scalar::bgrToGray, scalar::boxDownscale2x});
+	return result;
+}
+
+const char* isa() {
+	return dispatch().isa;
+}
+
+void swapRedBlue(uint8_t* pixels, size_t count) {
+	dispatch().swapRedBlue(pixels, count);
+}
+
+void bgrToGray(const uint8_t* bgr, uint8_t* gray, size_t count) {
+	dispatch().bgrToGray(bgr, gray, count);
+}
+
+void boxDownscale2x(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels) {
+	dispatch().boxDownscale2x(row0, row1, out, width, channels);
+}
+
+} //namespace tc::kernels
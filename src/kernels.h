@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Pixel kernels for 8-bit per channel rows, picked once at startup for the best instruction
+//set the CPU has (AVX-512, AVX2, SSSE3) with a scalar fallback for everything else.
+namespace tc::kernels
+{
+
+//Name of the instruction set the kernels were dispatched to, e.g. "avx2".
+const char* isa();
+
+//Swaps the first and third byte of count 24-bit pixels in place (BGR <-> RGB).
+void swapRedBlue(uint8_t* pixels, size_t count);
+
+//Converts count BGR pixels to 8-bit luma: (29 B + 150 G + 77 R + 128) / 256.
+void bgrToGray(const uint8_t* bgr, uint8_t* gray, size_t count);
+
+//Averages 2x2 blocks of two source rows into width output pixels of channels bytes each,
+//rounding to nearest. Source rows hold 2 * width pixels. Vectorized for 1, 3 and 4 channels.
+void boxDownscale2x(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels);
+
+//The kernels of one instruction set.
+struct Kernels
+{
+	const char* isa;
+	void (*swapRedBlue)(uint8_t*, size_t);
+	void (*bgrToGray)(const uint8_t*, uint8_t*, size_t);
+	void (*boxDownscale2x)(const uint8_t*, const uint8_t*, uint8_t*, size_t, int);
+};
+
+//Every instruction set the CPU runs, best first and scalar last, for checking and timing
+//them against each other. The functions above use the first.
+std::vector<Kernels> supported();
+
+namespace scalar
+{
+
+void swapRedBlue(uint8_t* pixels, size_t count);
+void bgrToGray(const uint8_t* bgr, uint8_t* gray, size_t count);
+void boxDownscale2x(const uint8_t* row0, const uint8_t* row1, uint8_t* out, size_t width, int channels);
+
+} //namespace scalar
+
+} //namespace tc::kernels
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <l_bitmap.h>
+#include <lterr.h>
+#include <ltfil.h>
+#include <ltkrn.h>
+
+#include "utils.h"
+
+namespace tc::leadtools
+{
+
+//What a failed call means for the job that made it.
+enum class ErrorCategory
+{
+	Transient,   //I/O hiccup, worth retrying as is
+	Resource,    //out of memory, worth retrying once load drops
+	Missing,     //input vanished or the name is bad
+	Corrupt,     //input is damaged
+	Unsupported, //format, compression or feature the SDK cannot handle
+	Usage,       //invalid parameters or setup; every following job fails the same way
+	Unknown
+};
+
+inline ErrorCategory classify(L_INT code) noexcept {
+	switch(code) {
+	case ERROR_FILE_READ:
+	case ERROR_FILE_WRITE:
+	case ERROR_FILE_LSEEK:
+	case ERROR_FILE_OPEN:
+		return ErrorCategory::Transient;
+	case ERROR_NO_MEMORY:
+	case ERROR_MEMORY_TOO_LOW:
+		return ErrorCategory::Resource;
+	case ERROR_FILENOTFOUND:
+	case ERROR_FILE_GONE:
+	case ERROR_INV_FILENAME:
+		return ErrorCategory::Missing;
+	case ERROR_CRC_CHECK:
+	case ERROR_INV_RANGE:
+		return ErrorCategory::Corrupt;
+	case ERROR_FILE_FORMAT:
+	case ERROR_UNKNOWN_COMP:
+	case ERROR_IMAGE_TYPE:
+	case ERROR_FEATURE_NOT_SUPPORTED:
+		return ErrorCategory::Unsupported;
+	case ERROR_INV_PARAMETER:
+	case ERROR_INVALID_STRUCT_SIZE:
+	case ERROR_NO_BITMAP:
+		return ErrorCategory::Usage;
+	default:
+		return ErrorCategory::Unknown;
+	}
+}
+
+inline const char* toString(ErrorCategory category) noexcept {
+	switch(category) {
+	case ErrorCategory::Transient: return "transient";
+	case ErrorCategory::Resource: return "resource";
+	case ErrorCategory::Missing: return "missing";
+	case ErrorCategory::Corrupt: return "corrupt";
+	case ErrorCategory::Unsupported: return "unsupported";
+	case ErrorCategory::Usage: return "usage";
+	case ErrorCategory::Unknown: break;
+	}
+	return "unknown";
+}
+
+//The message is only formatted when what() is called: batch runs mostly look at code()
+//and category(), and L_GetFriendlyErrorMessage is not free.
+//what() is not meant to be called concurrently on one exception object.
+class LeadToolsException : public tc::ExceptionWithErrorCode<L_INT>
+{
+public:
+	LeadToolsException(Code code) :
+		ExceptionWithErrorCode_(code, "Leadtools error")
+	{}
+
+	ErrorCategory category() const noexcept {
+		return classify(m_code);
+	}
+
+	const char* what() const noexcept override {
+		if(m_message.empty()) {
+			try {
+				m_message = "Leadtools error: code: " + std::to_string(m_code) + " msg: " + makeErrorString(m_code);
+			}
+			catch(...) {
+				return ExceptionWithErrorCode_::what();
+			}
+		}
+		return m_message.c_str();
+	}
+
+private:
+	static std::string makeErrorString(Code code) {
+		constexpr size_t bufSize = 1024;
+		char errBuf[bufSize] = {0};
+		L_GetFriendlyErrorMessage(code, errBuf, bufSize, false);
+		return errBuf;
+		// auto uniqWErrorString = tc::makeUnique(ltmmGetErrorText(code), SysFreeString);
+		// if(std::wcslen(uniqWErrorString.get()) == 0)
+		// {
+		// 	return "";
+		// }
+		// else
+		// {
+		// 	auto multiByteSize = WideCharToMultiByte(CP_UTF8, 0, uniqWErrorString.get(), -1, nullptr, 0, nullptr, nullptr);
+		// 	assert(multiByteSize > 0);
+		// 	auto uniqErrorString = std::make_unique<char[]>(multiByteSize);
+		// 	WideCharToMultiByte(CP_UTF8, 0, uniqWErrorString.get(), -1, uniqErrorString.get(), multiByteSize, nullptr, nullptr);
+		// 	assert(uniqErrorString[multiByteSize - 1] == 0);
+		// 	return uniqErrorString.get();
+		// }
+
+	}
+
+	mutable std::string m_message;
+};
+
+template<typename F, typename... Args>
+auto call(F f, Args&&... args) {
+	if(auto res = std::invoke(f, std::forward<Args>(args)...); res == SUCCESS) {
+		return res;
+	}
+	else {
+		throw LeadToolsException(res);
+	}
+}
+
+//Owns the pixel data of a loaded bitmap, so long-running modes do not leak a page per job.
+class Bitmap
+{
+public:
+	Bitmap() = default;
+	Bitmap(const Bitmap&) = delete;
+	Bitmap& operator=(const Bitmap&) = delete;
+
+	Bitmap(Bitmap&& other) noexcept
+	: m_handle(std::exchange(other.m_handle, BITMAPHANDLE{}))
+	{}
+
+	Bitmap& operator=(Bitmap&& other) noexcept {
+		if(this != &other) {
+			reset();
+			m_handle = std::exchange(other.m_handle, BITMAPHANDLE{});
+		}
+		return *this;
+	}
+
+	~Bitmap() {
+		reset();
+	}
+
+	pBITMAPHANDLE get() {
+		return &m_handle;
+	}
+
+	const BITMAPHANDLE& operator*() const {
+		return m_handle;
+	}
+
+	const BITMAPHANDLE* operator->() const {
+		return &m_handle;
+	}
+
+	//Hands the handle over to the caller, who frees it.
+	BITMAPHANDLE release() {
+		return std::exchange(m_handle, BITMAPHANDLE{});
+	}
+
+	void reset() {
+		if(m_handle.Flags.Allocated) {
+			L_FreeBitmap(&m_handle);
+		}
+		m_handle = BITMAPHANDLE{};
+	}
+
+private:
+	BITMAPHANDLE m_handle{};
+};
+
+//Keeps the bitmap data locked while rows are read and written directly.
+class BitmapAccess
+{
+public:
+	explicit BitmapAccess(BITMAPHANDLE& bitmap)
+	: m_bitmap(bitmap)
+	{
+		L_AccessBitmap(&m_bitmap);
+	}
+
+	BitmapAccess(const BitmapAccess&) = delete;
+	BitmapAccess& operator=(const BitmapAccess&) = delete;
+
+	~BitmapAccess() {
+		L_ReleaseBitmap(&m_bitmap);
+	}
+
+	void getRow(L_UCHAR* buffer, int row, size_t bytes) {
+		check(L_GetBitmapRow(&m_bitmap, buffer, row, bytes));
+	}
+
+	void putRow(L_UCHAR* buffer, int row, size_t bytes) {
+		check(L_PutBitmapRow(&m_bitmap, buffer, row, bytes));
+	}
+
+private:
+	static void check(L_SSIZE_T result) {
+		if(result < 0) {
+			throw LeadToolsException(static_cast<L_INT>(result));
+		}
+	}
+
+	BITMAPHANDLE& m_bitmap;
+};
+
+//8-bit bitmap holding gray levels: ORDER_GRAY or a palette mapping every index to its own level.
+inline bool isGray8(const BITMAPHANDLE& bitmap) {
+	if(bitmap.BitsPerPixel != 8) {
+		return false;
+	}
+	if(bitmap.Order == ORDER_GRAY) {
+		return true;
+	}
+	if(!bitmap.pPalette) {
+		return false;
+	}
+	for(L_UINT i = 0; i < bitmap.nColors; ++i) {
+		const auto& color = bitmap.pPalette[i];
+		if(color.rgbRed != i || color.rgbGreen != i || color.rgbBlue != i) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//Encodes bitmap into memory through L_SaveBitmapMemory, which hands out a global memory handle.
+inline std::vector<uint8_t> saveBitmapMemory(BITMAPHANDLE& bitmap, L_INT format, L_INT bitsPerPixel, L_INT qualityFactor, pSAVEFILEOPTION saveOptions = nullptr) {
+	L_HGLOBAL handle = nullptr;
+	L_SIZE_T size = 0;
+	call(L_SaveBitmapMemory, &handle, &bitmap, format, bitsPerPixel, qualityFactor, &size, saveOptions);
+	auto memory = tc::makeUnique(handle, L_GlobalFree);
+	const auto* data = static_cast<const uint8_t*>(L_GlobalLock(handle));
+	if(!data) {
+		throw LeadToolsException(ERROR_NO_MEMORY);
+	}
+	std::vector<uint8_t> bytes(data, data + size);
+	L_GlobalUnlock(handle);
+	return bytes;
+}
+
+} //namespace tc::leadtools
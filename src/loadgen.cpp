@@ -0,0 +1,569 @@
+//ltool_loadgen: replays a mix of sample documents at a fixed rate against the converter and
+//fails when throughput falls below a saved baseline or memory keeps growing. Meant for soak
+//runs of hours before a rollout, on any Linux box:
+//
+//  ltool_loadgen test --mix jpg=6,pdf=3,pptx=1 --rate 20 --duration 3600 --baseline soak.txt
+//
+//The load is open loop: request i is due at start + i/rate whatever the converter is doing,
+//and its latency counts from that moment, so a stalled converter shows up as latency instead
+//of quietly lowering the rate. The mix is drawn from a seeded generator, two runs with the
+//same options send the same sequence.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ltool/ltool.h>
+
+#include "args.h"
+
+extern char** environ;
+
+namespace
+{
+
+using namespace std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+//Resident set size of pid in bytes, 0 when it cannot be read.
+uint64_t residentBytes(const std::string& pid) {
+	std::ifstream status("/proc/" + pid + "/status");
+	std::string line;
+	while(std::getline(status, line)) {
+		if(line.compare(0, 6, "VmRSS:") == 0) {
+			return std::stoull(line.substr(6)) << 10;
+		}
+	}
+	return 0;
+}
+
+//"jpg=6,pdf=3,pptx=1": sample kinds by extension and their weights.
+std::map<std::string, double> parseMix(const std::string& text) {
+	std::map<std::string, double> mix;
+	std::istringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		const auto eq = item.find('=');
+		double weight = 1;
+		try {
+			if(eq != std::string::npos) {
+				weight = std::stod(item.substr(eq + 1));
+			}
+		}
+		catch(const std::exception&) {
+			weight = -1;
+		}
+		if(eq == 0 || weight < 0) {
+			throw std::logic_error("Invalid value for --mix: " + text);
+		}
+		mix[item.substr(0, eq)] = weight;
+	}
+	if(mix.empty()) {
+		throw std::logic_error("Invalid value for --mix: " + text);
+	}
+	return mix;
+}
+
+struct Sample
+{
+	std::string kind;
+	path file;
+};
+
+//The first file of each kind in dir, by name.
+std::vector<Sample> findSamples(const path& dir, const std::map<std::string, double>& mix) {
+	std::vector<path> files;
+	for(const auto& entry : directory_iterator(dir)) {
+		if(entry.is_regular_file()) {
+			files.push_back(entry.path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+	std::vector<Sample> samples;
+	for(const auto& [kind, weight] : mix) {
+		auto file = std::find_if(files.begin(), files.end(), [&kind = kind](const path& file) {
+			return file.extension() == "." + kind;
+		});
+		if(file == files.end()) {
+			throw std::runtime_error("No ." + kind + " sample in " + dir.string());
+		}
+		samples.push_back({kind, *file});
+	}
+	return samples;
+}
+
+//Where requests go. send() must not block for the conversion, done runs on any thread.
+class Target
+{
+public:
+	virtual ~Target() = default;
+
+	virtual void send(uint64_t id, const Sample& sample, std::function<void(bool succeeded)> done) = 0;
+
+	//Resident memory of whatever does the converting.
+	virtual uint64_t rss() const = 0;
+};
+
+//The library in this process, the way `ltool batch` converts.
+class BatchTarget : public Target
+{
+public:
+	BatchTarget(const path& workDir, size_t threads)
+	: m_outDir(workDir / "out"), m_converter(settings(threads))
+	{
+		create_directories(m_outDir);
+	}
+
+	void send(uint64_t id, const Sample& sample, std::function<void(bool)> done) override {
+		const auto output = m_outDir / ("req-" + std::to_string(id) + m_converter.extension());
+		m_converter.submit(sample.file, output, {}, [output, done = std::move(done)](std::exception_ptr error) {
+			std::error_code ec;
+			remove(output, ec);
+			done(!error);
+		});
+	}
+
+	uint64_t rss() const override {
+		return residentBytes("self");
+	}
+
+private:
+	static tc::ltool::ConverterSettings settings(size_t threads) {
+		tc::ltool::ConverterSettings settings;
+		settings.threads = threads;
+		settings.queue = threads * 2;
+		return settings;
+	}
+
+	const path m_outDir;
+	tc::ltool::Converter m_converter;
+};
+
+//An `ltool watch` daemon of its own, fed through its spool directory like a real client:
+//each request is written under a dot name and renamed in, and is done when the daemon moves
+//it to done/ or failed/.
+class WatchTarget : public Target
+{
+public:
+	WatchTarget(const path& ltool, const path& workDir, size_t threads)
+	: m_inDir(workDir / "in"), m_outDir(workDir / "out")
+	{
+		for(const auto& dir : {m_inDir, m_outDir, m_inDir / "done", m_inDir / "failed"}) {
+			create_directories(dir);
+		}
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(m_inotify < 0) {
+			throw std::system_error(errno, std::generic_category(), "inotify_init1");
+		}
+		for(const auto& [dir, succeeded] : {std::pair{m_inDir / "done", true}, {m_inDir / "failed", false}}) {
+			auto wd = inotify_add_watch(m_inotify, dir.c_str(), IN_MOVED_TO | IN_ONLYDIR);
+			if(wd < 0) {
+				throw std::system_error(errno, std::generic_category(), "inotify_add_watch " + dir.string());
+			}
+			m_outcomes[wd] = {dir, succeeded};
+		}
+		std::vector<std::string> args{ltool.string(), "watch", m_inDir.string(), m_outDir.string(), "--threads", std::to_string(threads)};
+		std::vector<char*> argv;
+		for(auto& arg : args) {
+			argv.push_back(arg.data());
+		}
+		argv.push_back(nullptr);
+		if(int error = posix_spawn(&m_pid, argv[0], nullptr, nullptr, argv.data(), environ)) {
+			throw std::system_error(error, std::generic_category(), "posix_spawn " + ltool.string());
+		}
+		m_listener = std::thread([this] {
+			listen();
+		});
+	}
+
+	~WatchTarget() override {
+		kill(m_pid, SIGTERM);
+		waitpid(m_pid, nullptr, 0);
+		m_stop = true;
+		m_listener.join();
+		close(m_inotify);
+	}
+
+	void send(uint64_t id, const Sample& sample, std::function<void(bool)> done) override {
+		const auto name = "req-" + std::to_string(id) + sample.file.extension().string();
+		{
+			std::lock_guard lock(m_mutex);
+			m_pending[name] = std::move(done);
+		}
+		const auto temporary = m_inDir / ("." + name);
+		copy_file(sample.file, temporary, copy_options::overwrite_existing);
+		rename(temporary, m_inDir / name);
+	}
+
+	uint64_t rss() const override {
+		return residentBytes(std::to_string(m_pid));
+	}
+
+private:
+	void listen() {
+		alignas(inotify_event) char buffer[4096];
+		while(!m_stop) {
+			pollfd pfd{m_inotify, POLLIN, 0};
+			if(poll(&pfd, 1, 200) <= 0) {
+				continue;
+			}
+			const auto length = read(m_inotify, buffer, sizeof(buffer));
+			for(char* p = buffer; length > 0 && p < buffer + length;) {
+				const auto* event = reinterpret_cast<const inotify_event*>(p);
+				p += sizeof(inotify_event) + event->len;
+				if(!event->len) {
+					continue;
+				}
+				const auto& [dir, succeeded] = m_outcomes[event->wd];
+				finish(dir / event->name, succeeded);
+			}
+		}
+	}
+
+	void finish(const path& file, bool succeeded) {
+		std::function<void(bool)> done;
+		{
+			std::lock_guard lock(m_mutex);
+			auto it = m_pending.find(file.filename().string());
+			if(it == m_pending.end()) {
+				return;
+			}
+			done = std::move(it->second);
+			m_pending.erase(it);
+		}
+		std::error_code ec;
+		remove(file, ec);
+		for(const auto& entry : directory_iterator(m_outDir, ec)) {
+			if(entry.path().stem() == file.stem()) {
+				remove(entry.path(), ec);
+			}
+		}
+		done(succeeded);
+	}
+
+	const path m_inDir;
+	const path m_outDir;
+	int m_inotify = -1;
+	pid_t m_pid = 0;
+	std::map<int, std::pair<path, bool>> m_outcomes;
+	std::mutex m_mutex;
+	std::map<std::string, std::function<void(bool)>> m_pending;
+	std::atomic<bool> m_stop{false};
+	std::thread m_listener;
+};
+
+double percentile(std::vector<double>& sorted, double fraction) {
+	if(sorted.empty()) {
+		return 0;
+	}
+	return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+//Completions of the current interval and the whole run after warmup.
+class Recorder
+{
+public:
+	struct Interval
+	{
+		size_t succeeded = 0;
+		size_t failed = 0;
+		std::vector<double> latencies;
+	};
+
+	void record(double latencyMs, bool succeeded, bool measured) {
+		std::lock_guard lock(m_mutex);
+		(succeeded ? m_interval.succeeded : m_interval.failed)++;
+		m_interval.latencies.push_back(latencyMs);
+		if(measured) {
+			(succeeded ? m_total.succeeded : m_total.failed)++;
+			m_total.latencies.push_back(latencyMs);
+		}
+		++m_completed;
+		m_changed.notify_all();
+	}
+
+	Interval takeInterval() {
+		std::lock_guard lock(m_mutex);
+		return std::exchange(m_interval, {});
+	}
+
+	Interval total() {
+		std::lock_guard lock(m_mutex);
+		return m_total;
+	}
+
+	uint64_t completed() {
+		std::lock_guard lock(m_mutex);
+		return m_completed;
+	}
+
+	bool waitFor(uint64_t completed, Clock::time_point deadline) {
+		std::unique_lock lock(m_mutex);
+		return m_changed.wait_until(lock, deadline, [&] {
+			return m_completed >= completed;
+		});
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	Interval m_interval;
+	Interval m_total;
+	uint64_t m_completed = 0;
+};
+
+//Calls tick with its due time on a thread of its own, every interval from start until
+//stopped. Stops when destroyed, so an exception leaving main does not destroy the thread
+//joinable, which would terminate the process before the error is printed.
+class Ticker
+{
+public:
+	Ticker(Clock::time_point start, Clock::duration interval, std::function<void(Clock::time_point)> tick)
+	: m_thread([this, start, interval, tick = std::move(tick)] {
+		for(auto next = start + interval;; next += interval) {
+			{
+				std::unique_lock lock(m_mutex);
+				if(m_stop.wait_until(lock, next, [&] { return m_stopping; })) {
+					return;
+				}
+			}
+			tick(next);
+		}
+	})
+	{}
+
+	Ticker(const Ticker&) = delete;
+	Ticker& operator=(const Ticker&) = delete;
+
+	~Ticker() {
+		stop();
+	}
+
+	//Waits for a tick under way to finish.
+	void stop() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_stop.notify_all();
+		if(m_thread.joinable()) {
+			m_thread.join();
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_stop;
+	bool m_stopping = false;
+	//Last, so the thread starts after the members it uses.
+	std::thread m_thread;
+};
+
+std::string mebibytes(uint64_t bytes) {
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1) << bytes / 1048576.0 << "M";
+	return out.str();
+}
+
+//"key value" lines, as --save writes them.
+std::map<std::string, double> readResults(const path& file) {
+	std::ifstream in(file);
+	if(!in) {
+		throw std::runtime_error("Cannot read " + file.string());
+	}
+	std::map<std::string, double> results;
+	std::string key;
+	double value;
+	while(in >> key >> value) {
+		results[key] = value;
+	}
+	return results;
+}
+
+} //namespace
+
+int main(int argc, char** argv)
+{
+	using namespace std::chrono;
+	try
+	{
+		const tc::Args args(argc, argv, {}, {"mode", "ltool", "rate", "duration", "warmup", "interval", "mix", "threads", "seed", "work", "drain", "baseline", "save", "tolerance", "max-rss-growth"});
+		if(args.positional().size() != 1) {
+			throw std::logic_error("Usage: ltool_loadgen SAMPLES_DIR [--mode batch|watch] [--rate N] [--duration S] [--mix jpg=6,pdf=3,pptx=1] [--baseline FILE] [--save FILE]");
+		}
+		const auto mode = args.value("mode").value_or("batch");
+		const auto rate = args.get<double>("rate", 10);
+		const auto runFor = seconds(args.get<unsigned>("duration", 60));
+		const auto warmup = seconds(args.get<unsigned>("warmup", 10));
+		const auto interval = seconds(std::max(1u, args.get<unsigned>("interval", 5)));
+		const auto threads = args.get<size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
+		const auto tolerance = args.get<double>("tolerance", 0.1);
+		const auto maxRssGrowth = args.getBytes("max-rss-growth", 64 << 20);
+		const auto drain = seconds(args.get<unsigned>("drain", 60));
+		const path workDir = args.value("work").value_or((temp_directory_path() / ("ltool_loadgen-" + std::to_string(getpid()))).string());
+		if(rate <= 0 || warmup >= runFor) {
+			throw std::logic_error("--rate must be positive and --warmup shorter than --duration");
+		}
+		const auto mix = parseMix(args.value("mix").value_or("jpg=6,pdf=3,pptx=1"));
+		const auto samples = findSamples(args.positional()[0], mix);
+		std::vector<double> weights;
+		for(const auto& sample : samples) {
+			weights.push_back(mix.at(sample.kind));
+		}
+		std::mt19937_64 random(args.get<uint64_t>("seed", 1));
+		std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+		//Declared before the target, so they outlive the callbacks its workers may still be
+		//running should the run end with an exception.
+		Recorder recorder;
+		std::atomic<uint64_t> completedInWindow{0};
+		std::unique_ptr<Target> target;
+		if(mode == "batch") {
+			tc::ltool::initialize(LICENSE_FILE, DEVELOPER_KEY);
+			target = std::make_unique<BatchTarget>(workDir, threads);
+		}
+		else if(mode == "watch") {
+			const path ltool = args.value("ltool").value_or((read_symlink("/proc/self/exe").parent_path() / "ltool").string());
+			target = std::make_unique<WatchTarget>(ltool, workDir, threads);
+		}
+		else {
+			throw std::logic_error("Invalid value for --mode: " + mode);
+		}
+
+		const auto start = Clock::now();
+		const auto measureFrom = start + warmup;
+		std::atomic<uint64_t> sent{0};
+		//RSS after warmup, one sample per interval.
+		std::vector<uint64_t> rssSamples;
+		Ticker reporter(start, interval, [&](Clock::time_point next) {
+			auto current = recorder.takeInterval();
+			std::sort(current.latencies.begin(), current.latencies.end());
+			const auto rss = target->rss();
+			if(next > measureFrom) {
+				rssSamples.push_back(rss);
+			}
+			std::cout << std::fixed << std::setprecision(1)
+				<< "t=" << duration_cast<seconds>(next - start).count() << "s"
+				<< " done=" << current.succeeded << " failed=" << current.failed
+				<< " rate=" << (current.succeeded + current.failed) / duration<double>(interval).count() << "/s"
+				<< " p50=" << percentile(current.latencies, 0.5) << "ms"
+				<< " p90=" << percentile(current.latencies, 0.9) << "ms"
+				<< " p99=" << percentile(current.latencies, 0.99) << "ms"
+				<< " max=" << (current.latencies.empty() ? 0 : current.latencies.back()) << "ms"
+				<< " in-flight=" << sent - recorder.completed()
+				<< " rss=" << mebibytes(rss) << std::endl;
+		});
+
+		const auto end = start + runFor;
+		for(uint64_t id = 0;; ++id) {
+			const auto due = start + duration_cast<Clock::duration>(duration<double>(id / rate));
+			if(due >= end) {
+				break;
+			}
+			std::this_thread::sleep_until(due);
+			const bool measured = due >= measureFrom;
+			++sent;
+			target->send(id, samples[pick(random)], [&, due, measured, end](bool succeeded) {
+				const auto now = Clock::now();
+				if(measured && now <= end) {
+					++completedInWindow;
+				}
+				recorder.record(duration<double, std::milli>(now - due).count(), succeeded, measured);
+			});
+		}
+		const bool drained = recorder.waitFor(sent, Clock::now() + drain);
+		reporter.stop();
+
+		auto total = recorder.total();
+		std::sort(total.latencies.begin(), total.latencies.end());
+		std::map<std::string, double> results;
+		//Completions within the measured window: what the converter kept up with, not the backlog.
+		results["throughput"] = completedInWindow / duration<double>(runFor - warmup).count();
+		results["p50_ms"] = percentile(total.latencies, 0.5);
+		results["p90_ms"] = percentile(total.latencies, 0.9);
+		results["p99_ms"] = percentile(total.latencies, 0.99);
+		results["failed"] = total.failed;
+		//Average of the last quarter of the samples over that of the first: a leak shows as a
+		//steady climb, while a single spike is smoothed out.
+		double rssGrowth = 0;
+		if(rssSamples.size() >= 4) {
+			const auto quarter = rssSamples.size() / 4;
+			auto average = [&](size_t from) {
+				double sum = 0;
+				for(size_t i = from; i < from + quarter; ++i) {
+					sum += rssSamples[i];
+				}
+				return sum / quarter;
+			};
+			rssGrowth = average(rssSamples.size() - quarter) - average(0);
+		}
+		results["rss_growth"] = rssGrowth;
+		std::cout << std::defaultfloat << std::setprecision(6);
+		for(const auto& [key, value] : results) {
+			std::cout << key << " " << value << std::endl;
+		}
+		if(auto file = args.value("save")) {
+			std::ofstream out(*file);
+			for(const auto& [key, value] : results) {
+				out << key << " " << value << "\n";
+			}
+		}
+
+		std::vector<std::string> failures;
+		if(!drained) {
+			failures.push_back("requests still in flight after draining");
+		}
+		if(total.failed) {
+			failures.push_back(std::to_string(total.failed) + " conversions failed");
+		}
+		if(rssGrowth > maxRssGrowth) {
+			failures.push_back("rss grew by " + mebibytes(rssGrowth) + ", more than " + mebibytes(maxRssGrowth));
+		}
+		if(auto file = args.value("baseline")) {
+			const auto baseline = readResults(*file);
+			if(auto it = baseline.find("throughput"); it != baseline.end() && results["throughput"] < it->second * (1 - tolerance)) {
+				std::ostringstream message;
+				message << "throughput " << results["throughput"] << "/s below baseline " << it->second << "/s";
+				failures.push_back(message.str());
+			}
+		}
+		target.reset();
+		std::error_code ec;
+		if(!args.value("work")) {
+			remove_all(workDir, ec);
+		}
+		for(const auto& failure : failures) {
+			std::cerr << "FAIL: " << failure << std::endl;
+		}
+		return failures.empty() ? 0 : 1;
+	}
+	catch(const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
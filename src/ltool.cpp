@@ -0,0 +1,319 @@
+#include <ltool/ltool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <utility>
+
+#include "affinity.h"
+#include "arena.h"
+#include "convert.h"
+#include "leadtools.h"
+#include "stats.h"
+#include "trace.h"
+#include "work_stealing.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+//Runs f, turning SDK exceptions into the public Error.
+template<typename F>
+auto translated(F&& f) {
+	try {
+		return f();
+	}
+	catch(const LeadToolsException& e) {
+		throw Error(e.code(), toString(e.category()), e.what());
+	}
+}
+
+ConvertOptions toConvertOptions(const RenderSettings& settings) {
+	ConvertOptions options;
+	options.pipeline = Pipeline::parse(settings.pipeline);
+	options.rasterize = RasterizePolicy::parse(settings.dpi, settings.pageSize);
+	if(!settings.crop.empty()) {
+		options.crop = parseRegion(settings.crop);
+	}
+	return options;
+}
+
+ConvertOptions toConvertOptions(const ConverterSettings& settings) {
+	auto options = toConvertOptions(settings.render);
+	if(settings.output == "tif" || settings.output == "tiff") {
+		options.container = Container::Tiff;
+	}
+	else if(settings.output == "pdf") {
+		options.container = Container::Pdf;
+	}
+	else if(settings.output == "svg") {
+		options.svg = true;
+	}
+	else if(settings.output != "png") {
+		throw std::logic_error("Invalid output format: " + settings.output);
+	}
+	if(options.svg && options.crop) {
+		throw std::logic_error("Crop does not apply to svg output");
+	}
+	options.maxBytes = settings.maxBytes;
+	if(options.maxBytes && (options.svg || options.container != Container::None)) {
+		throw std::logic_error("A byte limit applies to png output only");
+	}
+	options.png.builtin = settings.builtinPng;
+	options.pageThreads = std::max<size_t>(settings.pageThreads, 1);
+	return options;
+}
+
+//Runs work on pool and hands its outcome to done through resume.
+template<typename T, typename F>
+void runAsync(WorkStealingPool& pool, std::atomic<size_t>& pending, F work, Executor resume, Callback<T> done) {
+	++pending;
+	pool.post([&pending, work = std::move(work), resume = std::move(resume), done = std::move(done)]() mutable {
+		T result{};
+		std::exception_ptr error;
+		try {
+			result = work();
+		}
+		catch(...) {
+			error = std::current_exception();
+		}
+		std::function<void()> completion = [done = std::move(done), error, result = std::move(result)]() mutable {
+			done(error, std::move(result));
+		};
+		resume ? resume(std::move(completion)) : completion();
+		--pending;
+	});
+}
+
+} //namespace
+
+void initialize(const std::string& licenseFile, const std::string& developerKey) {
+	translated([&] {
+		call(L_SetLicenseFile, tc::strdup(licenseFile.c_str()).get(), tc::strdup(developerKey.c_str()).get());
+	});
+}
+
+struct Page::Impl
+{
+	Bitmap bitmap;
+};
+
+Page::Page(std::unique_ptr<Impl> impl)
+: m_impl(std::move(impl))
+{}
+
+Page::Page(Page&&) noexcept = default;
+Page& Page::operator=(Page&&) noexcept = default;
+Page::~Page() = default;
+
+int Page::width() const {
+	return m_impl->bitmap->Width;
+}
+
+int Page::height() const {
+	return m_impl->bitmap->Height;
+}
+
+int Page::bitsPerPixel() const {
+	return m_impl->bitmap->BitsPerPixel;
+}
+
+std::vector<uint8_t> Page::encode(Encoding encoding, int quality, size_t threads) {
+	return translated([&] {
+		auto& bitmap = *m_impl->bitmap.get();
+		trace::Span span("encode");
+		switch(encoding) {
+		case Encoding::Png:
+			if(canWritePng(bitmap)) {
+				std::ostringstream out;
+				encodePng(bitmap, out, PngOptions{}, threads);
+				const auto bytes = std::move(out).str();
+				return std::vector<uint8_t>(bytes.begin(), bytes.end());
+			}
+			return saveBitmapMemory(bitmap, FILE_PNG, 0, 0);
+		case Encoding::Jpeg:
+			return saveBitmapMemory(bitmap, FILE_JPEG, isGray8(bitmap) ? 8 : 24, quality);
+		case Encoding::Tiff:
+			break;
+		}
+		return saveBitmapMemory(bitmap, FILE_TIFLZW, 0, 0);
+	});
+}
+
+struct Document::Impl
+{
+	std::filesystem::path path;
+	FILEINFO fileInfo;
+	ConvertOptions options;
+};
+
+Document::Document(std::unique_ptr<Impl> impl)
+: m_impl(std::move(impl))
+{}
+
+Document::Document(Document&&) noexcept = default;
+Document& Document::operator=(Document&&) noexcept = default;
+Document::~Document() = default;
+
+Document Document::open(const std::filesystem::path& path, const RenderSettings& settings) {
+	auto impl = std::make_unique<Impl>();
+	impl->path = path;
+	impl->options = toConvertOptions(settings);
+	impl->fileInfo = translated([&] {
+		JobArena::Scope scratch;
+		return probe(path, impl->options.rasterize);
+	});
+	return Document(std::move(impl));
+}
+
+int Document::pageCount() const {
+	return std::max(m_impl->fileInfo.TotalPages, 1);
+}
+
+int Document::width() const {
+	return m_impl->fileInfo.Width;
+}
+
+int Document::height() const {
+	return m_impl->fileInfo.Height;
+}
+
+Page Document::render(int page) const {
+	return translated([&] {
+		if(page < 1 || page > pageCount()) {
+			throw LeadToolsException(ERROR_PAGE_NOT_FOUND);
+		}
+		JobArena::Scope scratch;
+		trace::FileScope traceFile(m_impl->path);
+		//The SDK may write to the file info, every render gets its own.
+		auto fileInfo = m_impl->fileInfo;
+		uint64_t decodedBytes = 0;
+		auto impl = std::make_unique<Page::Impl>();
+		impl->bitmap = renderPage(m_impl->path, fileInfo, page, m_impl->options, decodedBytes);
+		return Page(std::move(impl));
+	});
+}
+
+struct AsyncRenderer::Impl
+{
+	explicit Impl(size_t threads)
+	: pool(std::max<size_t>(threads, 1), 1)
+	{}
+
+	std::atomic<size_t> pending{0};
+	WorkStealingPool pool;
+};
+
+AsyncRenderer::AsyncRenderer(size_t threads)
+: m_impl(std::make_unique<Impl>(threads))
+{}
+
+AsyncRenderer::~AsyncRenderer() {
+	m_impl->pool.wait();
+}
+
+size_t AsyncRenderer::pending() const {
+	return m_impl->pending;
+}
+
+void AsyncRenderer::open(const std::filesystem::path& path, const RenderSettings& settings, Executor resume, Callback<std::shared_ptr<const Document>> done) {
+	runAsync(m_impl->pool, m_impl->pending, [path, settings] {
+		return std::make_shared<const Document>(Document::open(path, settings));
+	}, std::move(resume), std::move(done));
+}
+
+void AsyncRenderer::render(std::shared_ptr<const Document> document, int page, Executor resume, Callback<std::shared_ptr<Page>> done) {
+	runAsync(m_impl->pool, m_impl->pending, [document = std::move(document), page] {
+		return std::make_shared<Page>(document->render(page));
+	}, std::move(resume), std::move(done));
+}
+
+void AsyncRenderer::encode(std::shared_ptr<Page> page, Encoding encoding, int quality, Executor resume, Callback<std::vector<uint8_t>> done) {
+	runAsync(m_impl->pool, m_impl->pending, [page = std::move(page), encoding, quality] {
+		return page->encode(encoding, quality);
+	}, std::move(resume), std::move(done));
+}
+
+struct Converter::Impl
+{
+	Impl(const ConverterSettings& settings)
+	: options(toConvertOptions(settings))
+	, pool(settings.affinity ? makePinnedPool(settings.threads, settings.queue) : std::make_unique<WorkStealingPool>(settings.threads, settings.queue))
+	{}
+
+	//One conversion on a pool thread, counted in Stats like a batch job.
+	void run(const std::filesystem::path& input, const std::filesystem::path& output) const {
+		auto& stats = Stats::get();
+		JobArena::Scope scratch;
+		trace::FileScope traceFile(input);
+		trace::Span span("job");
+		try {
+			translated([&] {
+				auto fileInfo = probe(input, options);
+				convert(input, output, fileInfo, options);
+			});
+			stats.jobsSucceeded.add();
+		}
+		catch(const Error& e) {
+			stats.recordError(e.code(), e.category().c_str());
+			stats.jobsFailed.add();
+			throw;
+		}
+		catch(...) {
+			stats.jobsFailed.add();
+			throw;
+		}
+	}
+
+	const ConvertOptions options;
+	std::unique_ptr<WorkStealingPool> pool;
+};
+
+Converter::Converter(const ConverterSettings& settings)
+: m_impl(std::make_unique<Impl>(settings))
+{}
+
+Converter::~Converter() {
+	m_impl->pool->wait();
+}
+
+std::string Converter::extension() const {
+	return outputExtension(m_impl->options);
+}
+
+std::future<void> Converter::submit(const std::filesystem::path& input, const std::filesystem::path& output) {
+	auto promise = std::make_shared<std::promise<void>>();
+	auto future = promise->get_future();
+	m_impl->pool->submit([impl = m_impl.get(), input, output, promise] {
+		try {
+			impl->run(input, output);
+			promise->set_value();
+		}
+		catch(...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return future;
+}
+
+void Converter::submit(const std::filesystem::path& input, const std::filesystem::path& output, Executor resume, std::function<void(std::exception_ptr)> done) {
+	m_impl->pool->post([impl = m_impl.get(), input, output, resume = std::move(resume), done = std::move(done)] {
+		std::exception_ptr error;
+		try {
+			impl->run(input, output);
+		}
+		catch(...) {
+			error = std::current_exception();
+		}
+		std::function<void()> completion = [done, error] {
+			done(error);
+		};
+		resume ? resume(std::move(completion)) : completion();
+	});
+}
+
+} //namespace tc::ltool
@@ -1,14 +1,23 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <filesystem>
 #include <stdexcept>
-#include <memory>
 #include <string>
-#include <cstring>
-#include <functional>
+#include <thread>
+
+#include <unistd.h>
 
-#include <l_bitmap.h>
-#include <lterr.h>
-#include <ltfil.h>
+#include <ltool/ltool.h>
+
+#include "args.h"
+#include "batch.h"
+#include "convert.h"
+#include "preview.h"
+#include "thumbs.h"
+#include "trace.h"
+#include "watch.h"
 
 //#include <stringapiset.h>
 // #ifdef _WIN32
@@ -19,134 +28,189 @@
 // const char* MY_DEVELOPER_KEY("iswHXpNThJb/bVvDd9FDk5KRCMAXLmsI2t3u3sJp/TM=");
 // #endif
 
-namespace tc
-{
-
-template<typename T, typename D>
-auto makeUnique(T&& t, D&& d) {
-	return std::unique_ptr<std::remove_pointer_t<std::remove_reference_t<T>>, std::decay_t<D>>(
-		std::forward<T>(t),
-		std::forward<D>(d)
-	);
-}
-
-template<typename TCode, typename BaseException = std::runtime_error>
-class ExceptionWithErrorCode : public BaseException
+namespace
 {
-public:
-	using Code = TCode;
-
-	template<typename... BaseArgs>
-	ExceptionWithErrorCode(Code code, BaseArgs&&... args)
-	: BaseException(std::forward<BaseArgs>(args)...), m_code(code)
-	{}
-
-	const Code& code() const {
-		return m_code;
-	}
-
-protected:
-	using ExceptionWithErrorCode_ = ExceptionWithErrorCode;
-	Code m_code;
-};
 
-template<typename R, typename IndirectPointer>
-auto makeDirectDeleter(R(*deleter)(IndirectPointer)) {
-	return [deleter](std::remove_pointer_t<IndirectPointer> data) {
-		deleter(&data);
-	};
+//Half of the physical memory, leaving room for the rest of the system.
+uint64_t defaultMemoryBudget() {
+	return static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) / 2;
 }
 
-std::unique_ptr<char[]> strdup(const char* s) {
-	assert(s);
-	auto size = std::strlen(s);
-	auto dupped = std::make_unique<char[]>(size + 1);
-	std::copy(s, s + size, dupped.get());
-	dupped[size] = 0;
-	return dupped;
-}
-
-} //namespace tc
-
-namespace tc::leadtools
-{
-
-class LeadToolsException : public tc::ExceptionWithErrorCode<L_INT>
-{
-public:
-	LeadToolsException(Code code) :
-		ExceptionWithErrorCode_(code, "Leadtools error: code: " + std::to_string(code) + " msg: " + makeErrorString(code))
-	{}
-
-private:
-	static std::string makeErrorString(Code code) {
-		constexpr size_t bufSize = 1024;
-		char errBuf[bufSize] = {0};
-		L_GetFriendlyErrorMessage(code, errBuf, bufSize, false);
-		return errBuf;
-		// auto uniqWErrorString = tc::makeUnique(ltmmGetErrorText(code), SysFreeString);
-		// if(std::wcslen(uniqWErrorString.get()) == 0)
-		// {
-		// 	return "";
-		// }
-		// else
-		// {
-		// 	auto multiByteSize = WideCharToMultiByte(CP_UTF8, 0, uniqWErrorString.get(), -1, nullptr, 0, nullptr, nullptr);
-		// 	assert(multiByteSize > 0);
-		// 	auto uniqErrorString = std::make_unique<char[]>(multiByteSize);
-		// 	WideCharToMultiByte(CP_UTF8, 0, uniqWErrorString.get(), -1, uniqErrorString.get(), multiByteSize, nullptr, nullptr);
-		// 	assert(uniqErrorString[multiByteSize - 1] == 0);
-		// 	return uniqErrorString.get();
-		// }
-
-	}
-};
-
-template<typename F, typename... Args>
-auto call(F f, Args&&... args) {
-	if(auto res = std::invoke(f, std::forward<Args>(args)...); res == SUCCESS) {
-		return res;
-	}
-	else {
-		throw LeadToolsException(res);
-	}
-}
-
-}
+} //namespace
 
 int main(int argc, char** argv)
 {
 	using namespace std::filesystem;
-	using namespace tc::leadtools;
+	using namespace tc::ltool;
+	std::optional<path> traceFile;
+	int exitCode = 0;
 	try
 	{
-		if(argc != 3) {
+		const tc::Args args(argc, argv, {"svg", "phash", "affinity", "count-pages"}, {"threads", "queue", "metrics-port", "retries", "trace", "max-memory", "size", "quality", "out", "pipeline", "multipage", "page-threads", "page-window", "png-encoder", "png-filter", "png-level", "report", "dedupe", "state", "prefetch", "prefetch-bytes", "dpi", "page-size", "crop", "page", "max-bytes"});
+		const auto& positional = args.positional();
+		if(auto file = args.value("trace")) {
+			traceFile = *file;
+			tc::trace::enable();
+		}
+		{
+			tc::trace::Span span("license");
+			initialize(LICENSE_FILE, DEVELOPER_KEY);
+		}
+		const auto threads = args.get<size_t>("threads", std::max(1u, std::thread::hardware_concurrency()));
+		ErrorPolicy policy;
+		policy.retries = args.get<unsigned>("retries", policy.retries);
+		const auto maxMemory = args.getBytes("max-memory", defaultMemoryBudget());
+		ConvertOptions convertOptions;
+		convertOptions.svg = args.has("svg");
+		convertOptions.pipeline = Pipeline::parse(args.value("pipeline").value_or(""));
+		convertOptions.rasterize = RasterizePolicy::parse(args.value("dpi").value_or(""), args.value("page-size").value_or(""));
+		if(auto crop = args.value("crop")) {
+			if(convertOptions.svg) {
+				throw std::logic_error("--crop and --svg are exclusive");
+			}
+			convertOptions.crop = parseRegion(*crop);
+		}
+		if(auto container = args.value("multipage")) {
+			if(*container == "tif" || *container == "tiff") {
+				convertOptions.container = Container::Tiff;
+			}
+			else if(*container == "pdf") {
+				convertOptions.container = Container::Pdf;
+			}
+			else {
+				throw std::logic_error("Invalid value for --multipage: " + *container);
+			}
+			if(convertOptions.svg) {
+				throw std::logic_error("--multipage and --svg are exclusive");
+			}
+		}
+		convertOptions.maxBytes = args.getBytes("max-bytes", 0);
+		if(convertOptions.maxBytes && (convertOptions.svg || convertOptions.container != Container::None)) {
+			throw std::logic_error("--max-bytes applies to single page output, not to --svg or --multipage");
+		}
+		convertOptions.pageThreads = args.get<size_t>("page-threads", 1);
+		convertOptions.pageWindow = args.get<size_t>("page-window", convertOptions.pageWindow);
+		if(auto encoder = args.value("png-encoder")) {
+			if(*encoder != "sdk" && *encoder != "builtin") {
+				throw std::logic_error("Invalid value for --png-encoder: " + *encoder);
+			}
+			convertOptions.png.builtin = *encoder == "builtin";
+		}
+		if(auto filter = args.value("png-filter")) {
+			convertOptions.png.filter = parsePngFilter(*filter);
+		}
+		convertOptions.png.level = args.get<int>("png-level", convertOptions.png.level);
+		if(convertOptions.png.level < 0 || convertOptions.png.level > 9) {
+			throw std::logic_error("--png-level must be 0-9");
+		}
+		std::unique_ptr<Report> report;
+		std::unique_ptr<DuplicateIndex> duplicates;
+		if(args.value("dedupe")) {
+			duplicates = std::make_unique<DuplicateIndex>(args.get<int>("dedupe", 0));
+			convertOptions.duplicates = duplicates.get();
+		}
+		convertOptions.phash = args.has("phash") || duplicates;
+		if(auto file = args.value("report")) {
+			report = std::make_unique<Report>(*file);
+		}
+		else if(convertOptions.phash) {
+			report = std::make_unique<Report>();
+		}
+		convertOptions.report = report.get();
+		if(!positional.empty() && positional[0] == "watch") {
+			if(positional.size() != 3) {
+				throw std::logic_error("Invalid arguments");
+			}
+			WatchOptions options;
+			options.threads = threads;
+			options.queueCapacity = args.get<size_t>("queue", options.threads * 2);
+			options.metricsPort = args.get<uint16_t>("metrics-port", 0);
+			options.convert = convertOptions;
+			options.policy = policy;
+			options.maxMemory = maxMemory;
+			options.affinity = args.has("affinity");
+			watch(positional[1], positional[2], options);
+		}
+		else if(!positional.empty() && positional[0] == "batch") {
+			if(positional.size() != 3) {
+				throw std::logic_error("Invalid arguments");
+			}
+			BatchOptions options;
+			options.threads = threads;
+			//Page tasks only run on workers that have nothing else to do.
+			convertOptions.pageThreads = args.get<size_t>("page-threads", threads);
+			options.metricsPort = args.get<uint16_t>("metrics-port", 0);
+			options.convert = convertOptions;
+			options.policy = policy;
+			options.maxMemory = maxMemory;
+			options.affinity = args.has("affinity");
+			options.state = args.value("state").value_or("");
+			options.prefetch = args.get<size_t>("prefetch", 0);
+			options.prefetchBytes = args.getBytes("prefetch-bytes", options.prefetchBytes);
+			auto summary = batch(positional[1], positional[2], options);
+			std::cerr << "converted: " << summary.succeeded << " failed: " << summary.failed;
+			if(!options.state.empty()) {
+				std::cerr << " unchanged: " << summary.unchanged;
+			}
+			if(summary.aborted) {
+				std::cerr << " aborted, not started: " << summary.cancelled;
+			}
+			std::cerr << std::endl;
+			exitCode = summary.failed || summary.aborted ? 1 : 0;
+		}
+		else if(!positional.empty() && positional[0] == "thumbs") {
+			if(positional.size() != 2) {
+				throw std::logic_error("Invalid arguments");
+			}
+			ThumbsOptions options;
+			options.threads = threads;
+			options.size = args.get<int>("size", options.size);
+			options.quality = args.get<int>("quality", options.quality);
+			options.maxBytes = convertOptions.maxBytes;
+			options.outDir = args.value("out").value_or((path(positional[1]) / "thumbs").string());
+			options.rasterize = convertOptions.rasterize;
+			options.countPages = args.has("count-pages");
+			if(auto failed = thumbs(positional[1], options)) {
+				std::cerr << "failed: " << failed << std::endl;
+				exitCode = 1;
+			}
+		}
+		else if(!positional.empty() && positional[0] == "preview") {
+			if(positional.size() != 2) {
+				throw std::logic_error("Invalid arguments");
+			}
+			PreviewOptions options;
+			options.size = args.get<int>("size", options.size);
+			options.quality = args.get<int>("quality", options.quality);
+			options.page = args.get<int>("page", options.page);
+			tc::trace::FileScope traceScope(positional[1]);
+			convertOptions.pageThreads = args.get<size_t>("page-threads", threads);
+			progressive(positional[1], std::cout, convertOptions, options);
+		}
+		else if(positional.size() == 2) {
+			const path inputFile = positional[0];
+			const path outputFile = positional[1];
+			tc::trace::FileScope traceScope(inputFile);
+			//A single document has the whole machine to itself.
+			convertOptions.pageThreads = args.get<size_t>("page-threads", threads);
+			convert(inputFile, outputFile, convertOptions);
+		}
+		else {
 			throw std::logic_error("Invalid arguments");
 		}
-		call(L_SetLicenseFile, tc::strdup(LICENSE_FILE).get(), tc::strdup(DEVELOPER_KEY).get());
-		const path inputFile = argv[1];
-		const path outputFile = argv[2];
-		FILEINFO fileInfo{};
-		//BITMAPHANDLE page1 = { 0 };
-		//std::cout << "DOCUMENT: " << L_IsSupportLocked(L_SUPPORT_DOCUMENT) << std::endl;
-		//call(L_LoadBitmap, inputFile.string().data(), &page1, sizeof(BITMAPHANDLE), 24, ORDER_BGR, nullptr, nullptr);
-		//LOADFILEOPTION loadFileOption;
-		//LoadFileOption.PageNumber = 32000;   //get number of pages in the file
-        //L_FileInfo(pData->szFileName,&FileInfoSrc,sizeof(FILEINFO),FILEINFO_TOTALPAGES,&LoadFileOption);
-        call(L_FileInfo, tc::strdup(inputFile.string().c_str()).get(), &fileInfo, sizeof(FILEINFO), FILEINFO_TOTALPAGES, nullptr);
-        BITMAPHANDLE bitmap{};
-        LOADFILEOPTION loadOpt{};
-        call(L_GetDefaultLoadFileOption, &loadOpt, sizeof(LOADFILEOPTION));
-        loadOpt.PageNumber = 0;
-        call(L_LoadBitmap, tc::strdup(inputFile.string().c_str()).get(), &bitmap, sizeof(BITMAPHANDLE), 0, 0, &loadOpt, &fileInfo);
-        call(L_SaveBitmap, tc::strdup(outputFile.string().c_str()).get(), &bitmap, FILE_PNG, 0, 0, nullptr);
-        //L_SaveBitmap(tc::strdup(outputFile.string().c_str()).get(), &bitmap,
-		//call(L_FileInfo, inputFile.string().data(), &fileInfo, sizeof(FILEINFO), FILEINFO_TOTALPAGES, nullptr);
-		//throw LeadToolsException(ERROR_FILE_FORMAT);
 	}
 	catch(const std::exception& e) {
 		std::cerr << e.what() << std::endl;
-		return 1;
+		exitCode = 1;
 	}
-	return 0;
-}
\ No newline at end of file
+	if(traceFile) {
+		try {
+			tc::trace::write(*traceFile);
+		}
+		catch(const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			exitCode = 1;
+		}
+	}
+	return exitCode;
+}
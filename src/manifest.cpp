@@ -0,0 +1,215 @@
+#include "manifest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#include <zlib.h>
+
+#include "work_stealing.h"
+
+namespace tc::ltool
+{
+
+using namespace std::filesystem;
+
+namespace
+{
+
+const std::string header = "ltool-manifest\t1";
+
+std::string escape(const std::string& text) {
+	std::string result;
+	for(char c : text) {
+		switch(c) {
+		case '\\': result += "\\\\"; break;
+		case '\t': result += "\\t"; break;
+		case '\n': result += "\\n"; break;
+		default: result += c;
+		}
+	}
+	return result;
+}
+
+std::string unescape(const std::string& text) {
+	std::string result;
+	for(size_t i = 0; i < text.size(); ++i) {
+		if(text[i] != '\\' || i + 1 == text.size()) {
+			result += text[i];
+			continue;
+		}
+		switch(text[++i]) {
+		case 't': result += '\t'; break;
+		case 'n': result += '\n'; break;
+		default: result += text[i];
+		}
+	}
+	return result;
+}
+
+std::vector<std::string> split(const std::string& line) {
+	std::vector<std::string> fields;
+	std::istringstream stream(line);
+	for(std::string field; std::getline(stream, field, '\t');) {
+		fields.push_back(unescape(field));
+	}
+	return fields;
+}
+
+//CRC-32 of the whole content; zlib's runs at several GB/s, far below the cost of a decode.
+bool contentCrc(const path& file, uint32_t& crc) {
+	std::ifstream in(file, std::ios::binary);
+	if(!in) {
+		return false;
+	}
+	std::vector<char> buffer(1 << 20);
+	uLong value = crc32(0, Z_NULL, 0);
+	while(in) {
+		in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		value = crc32(value, reinterpret_cast<const Bytef*>(buffer.data()), static_cast<uInt>(in.gcount()));
+	}
+	if(in.bad()) {
+		return false;
+	}
+	crc = static_cast<uint32_t>(value);
+	return true;
+}
+
+//Same input however the batch directory was spelled.
+std::string keyOf(const path& input) {
+	std::error_code ec;
+	auto full = absolute(input, ec);
+	return (ec ? input : full).lexically_normal().string();
+}
+
+} //namespace
+
+Manifest::Manifest(const path& file)
+: m_file(file)
+{
+	std::ifstream in(file);
+	std::string line;
+	//Another version starts over: everything is converted once more.
+	if(!in || !std::getline(in, line) || line != header) {
+		return;
+	}
+	while(std::getline(in, line)) {
+		auto fields = split(line);
+		if(fields.size() != 6) {
+			continue;
+		}
+		try {
+			Entry entry;
+			entry.size = std::stoull(fields[1]);
+			entry.mtime = std::stoll(fields[2]);
+			entry.crc = static_cast<uint32_t>(std::stoul(fields[3], nullptr, 16));
+			entry.options = fields[4];
+			entry.output = fields[5];
+			m_previous[fields[0]] = std::move(entry);
+		}
+		catch(const std::exception&) {
+		}
+	}
+}
+
+std::vector<path> Manifest::stale(const std::vector<path>& inputs, const std::string& options,
+	const std::function<path(const path&)>& outputFor, size_t threads)
+{
+	struct Scan
+	{
+		Entry entry;
+		bool upToDate = false;
+	};
+	std::vector<Scan> scans(inputs.size());
+	std::atomic<size_t> next{0};
+	auto scan = [&] {
+		for(size_t i = next++; i < inputs.size(); i = next++) {
+			const auto& input = inputs[i];
+			auto& entry = scans[i].entry;
+			entry.options = options;
+			entry.output = outputFor(input).string();
+			std::error_code sizeError;
+			std::error_code timeError;
+			entry.size = file_size(input, sizeError);
+			const auto time = last_write_time(input, timeError);
+			if(sizeError || timeError) {
+				//Left to the conversion to report.
+				continue;
+			}
+			entry.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+			auto found = m_previous.find(keyOf(input));
+			std::error_code ec;
+			const bool candidate = found != m_previous.end()
+				&& found->second.options == entry.options
+				&& found->second.output == entry.output
+				&& found->second.size == entry.size
+				&& (entry.output.empty() || exists(entry.output, ec));
+			if(candidate && found->second.mtime == entry.mtime) {
+				entry.crc = found->second.crc;
+				scans[i].upToDate = true;
+			}
+			//Hashed before converting, so a change made meanwhile shows up next time.
+			else if(contentCrc(input, entry.crc)) {
+				scans[i].upToDate = candidate && found->second.crc == entry.crc;
+			}
+		}
+	};
+	runConcurrently(std::clamp<size_t>(threads, 1, std::max<size_t>(inputs.size(), 1)), scan);
+
+	std::vector<path> result;
+	std::lock_guard lock(m_mutex);
+	for(size_t i = 0; i < inputs.size(); ++i) {
+		auto key = keyOf(inputs[i]);
+		if(scans[i].upToDate) {
+			m_current[key] = std::move(scans[i].entry);
+		}
+		else {
+			m_stale[key] = std::move(scans[i].entry);
+			result.push_back(inputs[i]);
+		}
+	}
+	return result;
+}
+
+void Manifest::converted(const path& input) {
+	std::lock_guard lock(m_mutex);
+	auto found = m_stale.find(keyOf(input));
+	if(found != m_stale.end()) {
+		m_current[found->first] = found->second;
+	}
+}
+
+void Manifest::save() const {
+	std::vector<std::string> lines;
+	{
+		std::lock_guard lock(m_mutex);
+		for(const auto& [input, entry] : m_current) {
+			std::ostringstream line;
+			line << escape(input) << '\t' << entry.size << '\t' << entry.mtime << '\t' << std::hex << entry.crc << std::dec
+				<< '\t' << escape(entry.options) << '\t' << escape(entry.output);
+			lines.push_back(line.str());
+		}
+	}
+	std::sort(lines.begin(), lines.end());
+	//A crash while writing leaves the previous state.
+	auto temporary = m_file;
+	temporary += ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::trunc);
+		out << header << '\n';
+		for(const auto& line : lines) {
+			out << line << '\n';
+		}
+		out.close();
+		if(!out) {
+			throw std::system_error(errno, std::generic_category(), "write " + temporary.string());
+		}
+	}
+	rename(temporary, m_file);
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tc::ltool
+{
+
+//State of a previous batch over the same inputs, so that a re-run converts only what changed.
+//Per input it records size, modification time, a CRC-32 of the content, the conversion
+//options and the output. An input is up to date when the options match, the output still
+//exists, and either size and mtime are unchanged or, after a touch, the content hash is.
+//Stored as a tab separated text file, replaced atomically by save().
+class Manifest
+{
+public:
+	//Loads file when it exists; unreadable lines are dropped, their inputs get converted again.
+	explicit Manifest(const std::filesystem::path& file);
+
+	//Inputs to convert under options, checked on up to threads threads. Inputs left out are
+	//carried over to the next save().
+	std::vector<std::filesystem::path> stale(const std::vector<std::filesystem::path>& inputs, const std::string& options,
+		const std::function<std::filesystem::path(const std::filesystem::path&)>& outputFor, size_t threads);
+
+	//Records input, returned by stale(), as converted with its state seen then. Thread safe.
+	void converted(const std::filesystem::path& input);
+
+	//Writes the inputs up to date: those stale() left out and those since converted().
+	void save() const;
+
+private:
+	struct Entry
+	{
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		uint32_t crc = 0;
+		std::string options;
+		std::string output;
+	};
+
+	const std::filesystem::path m_file;
+	//As loaded.
+	std::unordered_map<std::string, Entry> m_previous;
+	//Waiting for converted().
+	std::unordered_map<std::string, Entry> m_stale;
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, Entry> m_current;
+};
+
+} //namespace tc::ltool
@@ -0,0 +1,221 @@
+#include "metrics.h"
+
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace tc::metrics
+{
+
+size_t currentShard() {
+	static std::atomic<size_t> nextShard{0};
+	thread_local const size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+	return shard;
+}
+
+uint64_t Counter::value() const {
+	uint64_t sum = 0;
+	for(const auto& cell : m_cells) {
+		sum += cell.value.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+: m_bounds(std::move(bounds))
+{
+	if(m_bounds.size() > maxBuckets) {
+		throw std::invalid_argument("Too many histogram buckets");
+	}
+}
+
+std::vector<uint64_t> Histogram::counts() const {
+	std::vector<uint64_t> result(m_bounds.size() + 1, 0);
+	for(const auto& shard : m_shards) {
+		for(size_t i = 0; i < result.size(); ++i) {
+			result[i] += shard.buckets[i].load(std::memory_order_relaxed);
+		}
+	}
+	return result;
+}
+
+double Histogram::sum() const {
+	uint64_t nanos = 0;
+	for(const auto& shard : m_shards) {
+		nanos += shard.sumNanos.load(std::memory_order_relaxed);
+	}
+	return nanos / 1e9;
+}
+
+Registry& Registry::global() {
+	static Registry registry;
+	return registry;
+}
+
+Registry::Entry* Registry::find(Type type, const std::string& name, const std::string& labels) {
+	for(auto& entry : m_entries) {
+		if(entry.name == name && entry.labels == labels) {
+			if(entry.type != type) {
+				throw std::logic_error("Metric " + name + " registered with another type");
+			}
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+	std::lock_guard lock(m_mutex);
+	if(auto* entry = find(Type::Counter, name, labels)) {
+		return *static_cast<Counter*>(entry->metric);
+	}
+	auto& counter = m_counters.emplace_back();
+	m_entries.push_back({Type::Counter, name, help, labels, &counter});
+	return counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+	std::lock_guard lock(m_mutex);
+	if(auto* entry = find(Type::Gauge, name, labels)) {
+		return *static_cast<Gauge*>(entry->metric);
+	}
+	auto& gauge = m_gauges.emplace_back();
+	m_entries.push_back({Type::Gauge, name, help, labels, &gauge});
+	return gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, std::vector<double> bounds, const std::string& labels) {
+	std::lock_guard lock(m_mutex);
+	if(auto* entry = find(Type::Histogram, name, labels)) {
+		return *static_cast<Histogram*>(entry->metric);
+	}
+	auto& histogram = m_histograms.emplace_back(std::move(bounds));
+	m_entries.push_back({Type::Histogram, name, help, labels, &histogram});
+	return histogram;
+}
+
+namespace
+{
+
+std::string withLabels(const std::string& name, const std::string& labels, const std::string& extra = "") {
+	if(labels.empty() && extra.empty()) {
+		return name;
+	}
+	return name + "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+} //namespace
+
+std::string Registry::render() const {
+	std::lock_guard lock(m_mutex);
+	std::ostringstream out;
+	std::vector<bool> rendered(m_entries.size(), false);
+	for(size_t i = 0; i < m_entries.size(); ++i) {
+		if(rendered[i]) {
+			continue;
+		}
+		const auto& family = m_entries[i];
+		static const char* typeNames[] = {"counter", "gauge", "histogram"};
+		out << "# HELP " << family.name << ' ' << family.help << '\n';
+		out << "# TYPE " << family.name << ' ' << typeNames[static_cast<int>(family.type)] << '\n';
+		for(size_t j = i; j < m_entries.size(); ++j) {
+			const auto& entry = m_entries[j];
+			if(entry.name != family.name) {
+				continue;
+			}
+			rendered[j] = true;
+			switch(entry.type) {
+			case Type::Counter:
+				out << withLabels(entry.name, entry.labels) << ' ' << static_cast<const Counter*>(entry.metric)->value() << '\n';
+				break;
+			case Type::Gauge:
+				out << withLabels(entry.name, entry.labels) << ' ' << static_cast<const Gauge*>(entry.metric)->value() << '\n';
+				break;
+			case Type::Histogram: {
+				const auto* histogram = static_cast<const Histogram*>(entry.metric);
+				auto counts = histogram->counts();
+				uint64_t cumulative = 0;
+				for(size_t b = 0; b < counts.size(); ++b) {
+					cumulative += counts[b];
+					std::ostringstream le;
+					if(b < histogram->bounds().size()) {
+						le << "le=\"" << histogram->bounds()[b] << '"';
+					}
+					else {
+						le << "le=\"+Inf\"";
+					}
+					out << withLabels(entry.name + "_bucket", entry.labels, le.str()) << ' ' << cumulative << '\n';
+				}
+				out << withLabels(entry.name + "_sum", entry.labels) << ' ' << histogram->sum() << '\n';
+				out << withLabels(entry.name + "_count", entry.labels) << ' ' << cumulative << '\n';
+				break;
+			}
+			}
+		}
+	}
+	return out.str();
+}
+
+Server::Server(uint16_t port)
+: m_socket(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0))
+{
+	if(m_socket < 0) {
+		throw std::system_error(errno, std::generic_category(), "socket");
+	}
+	int reuse = 1;
+	setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(m_socket, 8) < 0) {
+		auto error = errno;
+		close(m_socket);
+		throw std::system_error(error, std::generic_category(), "metrics endpoint on port " + std::to_string(port));
+	}
+	m_thread = std::thread([this] { run(); });
+}
+
+Server::~Server() {
+	//Wakes the blocked accept() with an error, which ends run().
+	shutdown(m_socket, SHUT_RDWR);
+	m_thread.join();
+	close(m_socket);
+}
+
+void Server::run() {
+	for(;;) {
+		int client = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+		if(client < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+		timeval timeout{1, 0};
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		char request[1024];
+		//Every path serves the same page, so the request itself only has to be drained.
+		if(recv(client, request, sizeof(request), 0) > 0) {
+			auto body = Registry::global().render();
+			auto response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+				+ std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+			for(size_t sent = 0; sent < response.size();) {
+				auto n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+				if(n <= 0) {
+					break;
+				}
+				sent += n;
+			}
+		}
+		close(client);
+	}
+}
+
+} //namespace tc::metrics
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tc::metrics
+{
+
+//Writers spread over this many cache lines, so concurrent updates from different
+//workers do not contend on one atomic.
+constexpr size_t shardCount = 16;
+
+size_t currentShard();
+
+struct alignas(64) Cell
+{
+	std::atomic<uint64_t> value{0};
+};
+
+class Counter
+{
+public:
+	void add(uint64_t n = 1) {
+		m_cells[currentShard()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	uint64_t value() const;
+
+private:
+	std::array<Cell, shardCount> m_cells;
+};
+
+class Gauge
+{
+public:
+	void add(int64_t n = 1) {
+		m_value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	void set(int64_t n) {
+		m_value.store(n, std::memory_order_relaxed);
+	}
+
+	int64_t value() const {
+		return m_value.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<int64_t> m_value{0};
+};
+
+class Histogram
+{
+public:
+	static constexpr size_t maxBuckets = 15;
+
+	//Upper bounds in ascending order, at most maxBuckets of them; +Inf is implicit.
+	explicit Histogram(std::vector<double> bounds);
+
+	void observe(double value) {
+		size_t bucket = 0;
+		while(bucket < m_bounds.size() && value > m_bounds[bucket]) {
+			++bucket;
+		}
+		auto& shard = m_shards[currentShard()];
+		shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		shard.sumNanos.fetch_add(static_cast<uint64_t>(value * 1e9), std::memory_order_relaxed);
+	}
+
+	const std::vector<double>& bounds() const {
+		return m_bounds;
+	}
+
+	//Non-cumulative counts per bucket, the last one being +Inf.
+	std::vector<uint64_t> counts() const;
+	double sum() const;
+
+private:
+	struct alignas(64) Shard
+	{
+		std::array<std::atomic<uint64_t>, maxBuckets + 1> buckets{};
+		std::atomic<uint64_t> sumNanos{0};
+	};
+
+	std::vector<double> m_bounds;
+	std::array<Shard, shardCount> m_shards;
+};
+
+//Observes the lifetime of the scope in seconds.
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(Histogram& histogram)
+	: m_histogram(histogram), m_start(std::chrono::steady_clock::now())
+	{}
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+	~ScopedTimer() {
+		m_histogram.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+	}
+
+private:
+	Histogram& m_histogram;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+//Owns metrics and renders them in the Prometheus text exposition format.
+//Lookups lock, so callers keep the returned references instead of looking up per event.
+class Registry
+{
+public:
+	static Registry& global();
+
+	//labels is the inside of the braces, e.g. stage="load"; metrics with the same name
+	//and different labels form one family.
+	Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+	Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	Histogram& histogram(const std::string& name, const std::string& help, std::vector<double> bounds, const std::string& labels = "");
+
+	std::string render() const;
+
+private:
+	enum class Type { Counter, Gauge, Histogram };
+
+	struct Entry
+	{
+		Type type;
+		std::string name;
+		std::string help;
+		std::string labels;
+		void* metric;
+	};
+
+	Entry* find(Type type, const std::string& name, const std::string& labels);
+
+	mutable std::mutex m_mutex;
+	std::deque<Entry> m_entries;
+	std::deque<Counter> m_counters;
+	std::deque<Gauge> m_gauges;
+	std::deque<Histogram> m_histograms;
+};
+
+//Serves Registry::global().render() over HTTP on 127.0.0.1:port from a background thread.
+class Server
+{
+public:
+	explicit Server(uint16_t port);
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+	~Server();
+
+private:
+	void run();
+
+	int m_socket;
+	std::thread m_thread;
+};
+
+} //namespace tc::metrics
@@ -0,0 +1,90 @@
+#include "page_writer.h"
+
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+OrderedPageWriter::OrderedPageWriter(std::filesystem::path output, L_INT format, size_t window)
+: m_output(std::move(output)), m_format(format), m_window(window ? window : 1)
+{
+	//Page 1 must start a new file instead of being appended to a stale one.
+	std::error_code ec;
+	std::filesystem::remove(m_output, ec);
+}
+
+void OrderedPageWriter::waitForSlot(int page) {
+	std::unique_lock lock(m_mutex);
+	m_changed.wait(lock, [&] {
+		return m_error || static_cast<size_t>(page - m_next) < m_window;
+	});
+	if(m_error) {
+		std::rethrow_exception(m_error);
+	}
+}
+
+void OrderedPageWriter::submit(int page, Bitmap bitmap) {
+	std::unique_lock lock(m_mutex);
+	if(m_error) {
+		std::rethrow_exception(m_error);
+	}
+	m_ready.emplace(page, std::move(bitmap));
+	if(m_writing) {
+		return;
+	}
+	m_writing = true;
+	for(auto it = m_ready.find(m_next); it != m_ready.end(); it = m_ready.find(m_next)) {
+		auto next = std::move(it->second);
+		m_ready.erase(it);
+		const int nextPage = m_next;
+		lock.unlock();
+		try {
+			append(nextPage, next);
+		}
+		catch(...) {
+			lock.lock();
+			m_error = std::current_exception();
+			m_writing = false;
+			m_ready.clear();
+			m_changed.notify_all();
+			throw;
+		}
+		next.reset();
+		lock.lock();
+		++m_next;
+		m_changed.notify_all();
+	}
+	m_writing = false;
+}
+
+void OrderedPageWriter::fail(std::exception_ptr error) {
+	std::lock_guard lock(m_mutex);
+	if(!m_error) {
+		m_error = error;
+	}
+	m_ready.clear();
+	m_changed.notify_all();
+}
+
+int OrderedPageWriter::written() const {
+	std::lock_guard lock(m_mutex);
+	return m_next - 1;
+}
+
+void OrderedPageWriter::append(int page, Bitmap& bitmap) {
+	auto& stats = Stats::get();
+	metrics::ScopedTimer timer(stats.saveSeconds);
+	trace::Span span("encode_append", page);
+	SAVEFILEOPTION saveOpt{};
+	call(L_GetDefaultSaveFileOption, &saveOpt, sizeof(SAVEFILEOPTION));
+	//Past the last page of an existing file, PageNumber appends.
+	saveOpt.PageNumber = page;
+	call(L_SaveBitmap, tc::scratchPath(m_output).get(), bitmap.get(), m_format, 0, 0, &saveOpt);
+	stats.pages.add();
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+//Appends pages rendered in any order to one multi-page file in page order.
+//Renderers call waitForSlot() before decoding a page, which keeps at most window pages
+//waiting in memory; whoever submits the next page in order writes it and every
+//consecutive page already waiting.
+class OrderedPageWriter
+{
+public:
+	OrderedPageWriter(std::filesystem::path output, L_INT format, size_t window);
+
+	//Blocks while page is window or more pages ahead of the next one to write.
+	//Throws the write error if writing has failed.
+	void waitForSlot(int page);
+
+	//page is 1-based. Throws if writing this or an earlier page fails.
+	void submit(int page, leadtools::Bitmap bitmap);
+
+	//Wakes waiting renderers with error, e.g. when rendering a page failed.
+	void fail(std::exception_ptr error);
+
+	int written() const;
+
+private:
+	void append(int page, leadtools::Bitmap& bitmap);
+
+	const std::filesystem::path m_output;
+	const L_INT m_format;
+	const size_t m_window;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::map<int, leadtools::Bitmap> m_ready;
+	int m_next = 1;
+	bool m_writing = false;
+	std::exception_ptr m_error;
+};
+
+} //namespace tc::ltool
@@ -0,0 +1,122 @@
+#include "phash.h"
+
+#include <array>
+#include <stdexcept>
+
+#include "kernels.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+constexpr int gridWidth = 9;
+constexpr int gridHeight = 8;
+
+} //namespace
+
+uint64_t pageHash(BITMAPHANDLE& bitmap) {
+	if(bitmap.Width <= 0 || bitmap.Height <= 0) {
+		return 0;
+	}
+	const bool color = bitmap.BitsPerPixel == 24 && (bitmap.Order == ORDER_BGR || bitmap.Order == ORDER_RGB);
+	if(!color && !isGray8(bitmap)) {
+		//Rare layouts (1/4-bit, palettes, 16/32-bit) take a 24-bit copy first.
+		Bitmap copy;
+		call(L_CopyBitmap, copy.get(), &bitmap, sizeof(BITMAPHANDLE));
+		call(L_ColorResBitmap, copy.get(), copy.get(), sizeof(BITMAPHANDLE), 24, CRF_BYTEORDERBGR, nullptr, nullptr, 0, nullptr, nullptr);
+		return pageHash(*copy.get());
+	}
+	const size_t width = bitmap.Width;
+	std::array<uint64_t, gridWidth * gridHeight> sums{};
+	std::array<uint64_t, gridWidth * gridHeight> counts{};
+	std::vector<uint8_t> row(width * (color ? 3 : 1));
+	std::vector<uint8_t> luma(width);
+	//Grid column of every pixel, worked out once.
+	std::vector<uint8_t> column(width);
+	for(size_t x = 0; x < width; ++x) {
+		column[x] = static_cast<uint8_t>(x * gridWidth / width);
+	}
+	{
+		BitmapAccess access(bitmap);
+		for(int y = 0; y < bitmap.Height; ++y) {
+			access.getRow(row.data(), y, row.size());
+			const uint8_t* pixels = row.data();
+			if(color) {
+				//Red and blue weigh differently, so RGB rows are put in BGR order first.
+				if(bitmap.Order == ORDER_RGB) {
+					kernels::swapRedBlue(row.data(), width);
+				}
+				kernels::bgrToGray(row.data(), luma.data(), width);
+				pixels = luma.data();
+			}
+			//Rows come in storage order; bottom-up bitmaps are binned backwards so every page hashes top down.
+			const int line = bitmap.ViewPerspective == BOTTOM_LEFT ? bitmap.Height - 1 - y : y;
+			const size_t cell = static_cast<size_t>(line) * gridHeight / bitmap.Height * gridWidth;
+			for(size_t x = 0; x < width; ++x) {
+				sums[cell + column[x]] += pixels[x];
+				++counts[cell + column[x]];
+			}
+		}
+	}
+	std::array<uint64_t, gridWidth * gridHeight> means{};
+	for(size_t i = 0; i < means.size(); ++i) {
+		//Fixed point keeps cells of narrow pages comparable.
+		means[i] = counts[i] ? (sums[i] << 8) / counts[i] : 0;
+	}
+	uint64_t hash = 0;
+	for(int y = 0; y < gridHeight; ++y) {
+		for(int x = 0; x + 1 < gridWidth; ++x) {
+			hash <<= 1;
+			hash |= means[y * gridWidth + x] < means[y * gridWidth + x + 1] ? 1 : 0;
+		}
+	}
+	return hash;
+}
+
+DuplicateIndex::DuplicateIndex(int maxDistance)
+: m_maxDistance(maxDistance)
+{
+	if(maxDistance < 0 || maxDistance > 7) {
+		throw std::logic_error("Near-duplicate distance must be 0-7");
+	}
+}
+
+std::optional<std::filesystem::path> DuplicateIndex::findOrInsert(uint64_t hash, const std::filesystem::path& output) {
+	std::lock_guard lock(m_mutex);
+	for(int band = 0; band < 8; ++band) {
+		auto [first, last] = m_bands.equal_range(key(hash, band));
+		for(auto it = first; it != last; ++it) {
+			const auto& entry = m_entries[it->second];
+			//A retried job finds its own earlier attempt.
+			if(entry.output != output && hammingDistance(entry.hash, hash) <= m_maxDistance) {
+				return entry.output;
+			}
+		}
+	}
+	m_entries.push_back({hash, output});
+	for(int band = 0; band < 8; ++band) {
+		m_bands.emplace(key(hash, band), m_entries.size() - 1);
+	}
+	return std::nullopt;
+}
+
+void DuplicateIndex::remove(uint64_t hash, const std::filesystem::path& output) {
+	std::lock_guard lock(m_mutex);
+	for(int band = 0; band < 8; ++band) {
+		auto [first, last] = m_bands.equal_range(key(hash, band));
+		for(auto it = first; it != last;) {
+			if(m_entries[it->second].output == output) {
+				it = m_bands.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
+
+} //namespace tc::ltool
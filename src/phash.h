@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+//64-bit difference hash (dHash) of the page: luma averaged over a 9x8 grid, one bit per
+//cell that is darker than its right neighbour. Survives rescaling, recompression and small
+//brightness shifts; visually similar pages differ in few bits.
+uint64_t pageHash(BITMAPHANDLE& bitmap);
+
+inline int hammingDistance(uint64_t a, uint64_t b) {
+	int bits = 0;
+	for(auto diff = a ^ b; diff; diff &= diff - 1) {
+		++bits;
+	}
+	return bits;
+}
+
+//Hashes of the pages written so far, shared by all jobs of the run.
+class DuplicateIndex
+{
+public:
+	//Hashes up to maxDistance bits apart count as the same page; at most 7 so that a match
+	//always shares one of the eight bytes it is indexed by.
+	explicit DuplicateIndex(int maxDistance);
+
+	//Output of an earlier page near hash, otherwise records output under hash and returns nothing.
+	std::optional<std::filesystem::path> findOrInsert(uint64_t hash, const std::filesystem::path& output);
+
+	//Forgets output recorded under hash, for an output that could not be written after all.
+	void remove(uint64_t hash, const std::filesystem::path& output);
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		std::filesystem::path output;
+	};
+
+	static uint16_t key(uint64_t hash, int band) {
+		return static_cast<uint16_t>(band << 8 | ((hash >> (band * 8)) & 0xFF));
+	}
+
+	int m_maxDistance;
+	std::mutex m_mutex;
+	std::vector<Entry> m_entries;
+	std::unordered_multimap<uint16_t, size_t> m_bands;
+};
+
+} //namespace tc::ltool
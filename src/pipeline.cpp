@@ -0,0 +1,223 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+#include <ltimgcor.h>
+#include <ltimgefx.h>
+#include <ltkrn.h>
+
+#include "kernels.h"
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+constexpr L_COLORREF white = 0xFFFFFF;
+
+int parseInt(const std::string& text, const std::string& stage) {
+	size_t end = 0;
+	int value = 0;
+	try {
+		value = std::stoi(text, &end);
+	}
+	catch(const std::exception&) {
+		end = 0;
+	}
+	if(end == 0 || end != text.size()) {
+		throw std::logic_error("Invalid parameter of pipeline stage " + stage + ": " + text);
+	}
+	return value;
+}
+
+//Swaps the converted result into bitmap, freeing the original.
+void replace(BITMAPHANDLE& bitmap, Bitmap& result) {
+	result.get()->XResolution = bitmap.XResolution;
+	result.get()->YResolution = bitmap.YResolution;
+	Bitmap original;
+	*original.get() = bitmap;
+	bitmap = result.release();
+}
+
+Bitmap createLike(const BITMAPHANDLE& bitmap, int width, int height, int bitsPerPixel, int order, L_RGBQUAD* palette) {
+	Bitmap result;
+	call(L_CreateBitmap, result.get(), sizeof(BITMAPHANDLE), TYPE_CONV, width, height, bitsPerPixel, order, palette, bitmap.ViewPerspective, nullptr, 0);
+	return result;
+}
+
+//24-bit color to 8-bit gray through the vector kernels, one row at a time.
+bool fastGrayScale(BITMAPHANDLE& bitmap) {
+	if(bitmap.BitsPerPixel != 24 || (bitmap.Order != ORDER_BGR && bitmap.Order != ORDER_RGB)) {
+		return false;
+	}
+	std::array<L_RGBQUAD, 256> palette{};
+	for(size_t i = 0; i < palette.size(); ++i) {
+		const auto level = static_cast<L_UCHAR>(i);
+		palette[i] = {level, level, level, 0};
+	}
+	auto gray = createLike(bitmap, bitmap.Width, bitmap.Height, 8, ORDER_BGR, palette.data());
+	const size_t width = bitmap.Width;
+	std::vector<L_UCHAR> source(width * 3);
+	std::vector<L_UCHAR> target(width);
+	{
+		BitmapAccess in(bitmap);
+		BitmapAccess out(*gray.get());
+		for(int row = 0; row < bitmap.Height; ++row) {
+			in.getRow(source.data(), row, source.size());
+			if(bitmap.Order == ORDER_RGB) {
+				kernels::swapRedBlue(source.data(), width);
+			}
+			kernels::bgrToGray(source.data(), target.data(), width);
+			out.putRow(target.data(), row, target.size());
+		}
+	}
+	replace(bitmap, gray);
+	return true;
+}
+
+//Exact halving of 8, 24 and 32-bit bitmaps as a 2x2 box filter through the vector kernels.
+bool fastHalve(BITMAPHANDLE& bitmap, int width, int height) {
+	if(width != bitmap.Width / 2 || height != bitmap.Height / 2 || width == 0 || height == 0) {
+		return false;
+	}
+	const int channels = bitmap.BitsPerPixel / 8;
+	if(bitmap.BitsPerPixel % 8 != 0 || (channels != 1 && channels != 3 && channels != 4)) {
+		return false;
+	}
+	//Palette indices cannot be averaged, only gray levels.
+	if(channels == 1 && !isGray8(bitmap)) {
+		return false;
+	}
+	auto half = createLike(bitmap, width, height, bitmap.BitsPerPixel, bitmap.Order, bitmap.pPalette);
+	const size_t sourceBytes = static_cast<size_t>(bitmap.Width) * channels;
+	std::vector<L_UCHAR> top(sourceBytes);
+	std::vector<L_UCHAR> bottom(sourceBytes);
+	std::vector<L_UCHAR> target(static_cast<size_t>(width) * channels);
+	{
+		BitmapAccess in(bitmap);
+		BitmapAccess out(*half.get());
+		for(int row = 0; row < height; ++row) {
+			in.getRow(top.data(), 2 * row, top.size());
+			in.getRow(bottom.data(), 2 * row + 1, bottom.size());
+			kernels::boxDownscale2x(top.data(), bottom.data(), target.data(), width, channels);
+			out.putRow(target.data(), row, target.size());
+		}
+	}
+	replace(bitmap, half);
+	return true;
+}
+
+} //namespace
+
+Pipeline Pipeline::parse(const std::string& spec) {
+	Pipeline pipeline;
+	std::istringstream stream(spec);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		if(item.empty()) {
+			continue;
+		}
+		const auto eq = item.find('=');
+		const std::string name = item.substr(0, eq);
+		const std::string parameter = eq == std::string::npos ? "" : item.substr(eq + 1);
+		const bool parameterized = name == "resize" || name == "rotate";
+		if(parameterized == parameter.empty()) {
+			throw std::logic_error("Invalid pipeline stage: " + item);
+		}
+		Stage stage{};
+		if(name == "deskew") {
+			stage.operation = Operation::Deskew;
+		}
+		else if(name == "autocrop") {
+			stage.operation = Operation::AutoCrop;
+		}
+		else if(name == "grayscale") {
+			stage.operation = Operation::GrayScale;
+		}
+		else if(name == "despeckle") {
+			stage.operation = Operation::Despeckle;
+		}
+		else if(name == "rotate") {
+			stage.operation = Operation::Rotate;
+			stage.first = parseInt(parameter, name);
+		}
+		else if(name == "resize") {
+			stage.operation = Operation::Resize;
+			const auto x = parameter.find('x');
+			if(x == std::string::npos) {
+				throw std::logic_error("Invalid pipeline stage: " + item);
+			}
+			stage.first = parseInt(parameter.substr(0, x), name);
+			stage.second = parseInt(parameter.substr(x + 1), name);
+			if(stage.first < 0 || stage.second < 0 || (stage.first == 0 && stage.second == 0)) {
+				throw std::logic_error("Invalid pipeline stage: " + item);
+			}
+		}
+		else {
+			throw std::logic_error("Unknown pipeline stage: " + name);
+		}
+		pipeline.m_stages.push_back(stage);
+		pipeline.m_spec += (pipeline.m_spec.empty() ? "" : ",") + item;
+	}
+	return pipeline;
+}
+
+void Pipeline::apply(BITMAPHANDLE& bitmap) const {
+	for(const auto& stage : m_stages) {
+		switch(stage.operation) {
+		case Operation::Deskew: {
+			trace::Span span("deskew");
+			L_INT32 angle = 0;
+			call(L_DeskewBitmap, &bitmap, &angle, white, DSKW_PROCESS | DSKW_FILL);
+			break;
+		}
+		case Operation::AutoCrop: {
+			trace::Span span("autocrop");
+			call(L_AutoCropBitmap, &bitmap, 0, 0);
+			break;
+		}
+		case Operation::GrayScale: {
+			trace::Span span("grayscale");
+			if(!fastGrayScale(bitmap)) {
+				call(L_GrayScaleBitmap, &bitmap, 8);
+			}
+			break;
+		}
+		case Operation::Resize: {
+			trace::Span span("resize");
+			auto width = stage.first;
+			auto height = stage.second;
+			if(width == 0) {
+				width = std::max(1, static_cast<int>(static_cast<long long>(bitmap.Width) * height / std::max(bitmap.Height, 1)));
+			}
+			else if(height == 0) {
+				height = std::max(1, static_cast<int>(static_cast<long long>(bitmap.Height) * width / std::max(bitmap.Width, 1)));
+			}
+			if(!fastHalve(bitmap, width, height)) {
+				call(L_SizeBitmap, &bitmap, width, height, SIZE_RESAMPLE);
+			}
+			break;
+		}
+		case Operation::Despeckle: {
+			trace::Span span("despeckle");
+			call(L_DespeckleBitmap, &bitmap, 0);
+			break;
+		}
+		case Operation::Rotate: {
+			trace::Span span("rotate");
+			//L_RotateBitmap takes hundredths of a degree.
+			call(L_RotateBitmap, &bitmap, stage.first * 100, ROTATE_RESIZE | ROTATE_RESAMPLE, white);
+			break;
+		}
+		}
+	}
+}
+
+} //namespace tc::ltool
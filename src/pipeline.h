@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+//Image processing applied in place between load and save, so a conversion stays one decode
+//and one encode. Built from a comma separated spec such as
+//"deskew,autocrop,grayscale,resize=800x600,despeckle,rotate=90".
+//resize takes WIDTHxHEIGHT, either side 0 keeping the aspect ratio; rotate takes degrees clockwise.
+//grayscale of 24-bit color and resize to exactly half size run on the vector kernels in
+//kernels.h, other inputs go through the SDK.
+class Pipeline
+{
+public:
+	//Throws std::logic_error for unknown stages or bad parameters.
+	static Pipeline parse(const std::string& spec);
+
+	bool empty() const {
+		return m_stages.empty();
+	}
+
+	//Stages as parsed, empty items dropped.
+	const std::string& spec() const {
+		return m_spec;
+	}
+
+	void apply(BITMAPHANDLE& bitmap) const;
+
+private:
+	enum class Operation
+	{
+		Deskew,
+		AutoCrop,
+		GrayScale,
+		Resize,
+		Despeckle,
+		Rotate
+	};
+
+	struct Stage
+	{
+		Operation operation;
+		int first = 0;
+		int second = 0;
+	};
+
+	std::vector<Stage> m_stages;
+	std::string m_spec;
+};
+
+} //namespace tc::ltool
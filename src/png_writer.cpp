@@ -0,0 +1,413 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "kernels.h"
+#include "trace.h"
+#include "work_stealing.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+//Uncompressed bytes per deflate chunk, as in pigz.
+constexpr size_t chunkBytes = 256 * 1024;
+//Deflate window, the history a chunk is primed with.
+constexpr size_t windowBytes = 32 * 1024;
+
+enum ColorType : uint8_t
+{
+	Gray = 0,
+	Rgb = 2,
+	Indexed = 3
+};
+
+struct Layout
+{
+	ColorType colorType;
+	size_t channels;
+	bool swapRedBlue;
+};
+
+bool layoutOf(const BITMAPHANDLE& bitmap, Layout& layout) {
+	if(bitmap.BitsPerPixel == 24 && (bitmap.Order == ORDER_BGR || bitmap.Order == ORDER_RGB)) {
+		layout = {Rgb, 3, bitmap.Order == ORDER_BGR};
+		return true;
+	}
+	if(isGray8(bitmap)) {
+		layout = {Gray, 1, false};
+		return true;
+	}
+	if(bitmap.BitsPerPixel == 8 && bitmap.pPalette && bitmap.nColors > 0 && bitmap.nColors <= 256) {
+		layout = {Indexed, 1, false};
+		return true;
+	}
+	return false;
+}
+
+uint8_t paeth(int left, int up, int upLeft) {
+	const int estimate = left + up - upLeft;
+	const int toLeft = std::abs(estimate - left);
+	const int toUp = std::abs(estimate - up);
+	const int toUpLeft = std::abs(estimate - upLeft);
+	if(toLeft <= toUp && toLeft <= toUpLeft) {
+		return static_cast<uint8_t>(left);
+	}
+	return static_cast<uint8_t>(toUp <= toUpLeft ? up : upLeft);
+}
+
+//Writes the filter type byte and the filtered row to out, returns the adaptive heuristic.
+uint64_t filterRow(PngFilter filter, const uint8_t* row, const uint8_t* prior, size_t bytes, size_t step, uint8_t* out) {
+	out[0] = static_cast<uint8_t>(filter);
+	uint8_t* data = out + 1;
+	for(size_t i = 0; i < bytes; ++i) {
+		const int left = i >= step ? row[i - step] : 0;
+		const int up = prior[i];
+		const int upLeft = i >= step ? prior[i - step] : 0;
+		int predicted = 0;
+		switch(filter) {
+		case PngFilter::None: break;
+		case PngFilter::Sub: predicted = left; break;
+		case PngFilter::Up: predicted = up; break;
+		case PngFilter::Average: predicted = (left + up) >> 1; break;
+		case PngFilter::Paeth: predicted = paeth(left, up, upLeft); break;
+		case PngFilter::Adaptive: break;
+		}
+		data[i] = static_cast<uint8_t>(row[i] - predicted);
+	}
+	uint64_t cost = 0;
+	for(size_t i = 0; i < bytes; ++i) {
+		cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(data[i])));
+	}
+	return cost;
+}
+
+//Reads rows top down in PNG byte order. The SDK calls are serialized, the copies are cheap
+//next to filtering and deflate.
+class RowReader
+{
+public:
+	RowReader(BITMAPHANDLE& bitmap, const Layout& layout)
+	: m_access(bitmap)
+	, m_layout(layout)
+	, m_bytes(static_cast<size_t>(bitmap.Width) * layout.channels)
+	{}
+
+	size_t rowBytes() const {
+		return m_bytes;
+	}
+
+	void read(int row, uint8_t* buffer) {
+		{
+			std::lock_guard lock(m_mutex);
+			m_access.getRow(buffer, row, m_bytes);
+		}
+		if(m_layout.swapRedBlue) {
+			kernels::swapRedBlue(buffer, m_bytes / 3);
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	BitmapAccess m_access;
+	Layout m_layout;
+	size_t m_bytes;
+};
+
+//Filtered PNG scanlines of rows [first, last).
+std::vector<uint8_t> filterRows(RowReader& reader, int first, int last, PngFilter filter, size_t step) {
+	const size_t bytes = reader.rowBytes();
+	std::vector<uint8_t> prior(bytes, 0);
+	std::vector<uint8_t> row(bytes);
+	if(first > 0) {
+		reader.read(first - 1, prior.data());
+	}
+	std::vector<uint8_t> filtered(static_cast<size_t>(last - first) * (bytes + 1));
+	std::vector<uint8_t> candidate(filter == PngFilter::Adaptive ? bytes + 1 : 0);
+	for(int y = first; y < last; ++y) {
+		reader.read(y, row.data());
+		uint8_t* out = filtered.data() + static_cast<size_t>(y - first) * (bytes + 1);
+		if(filter == PngFilter::Adaptive) {
+			auto best = filterRow(PngFilter::None, row.data(), prior.data(), bytes, step, out);
+			for(auto type : {PngFilter::Sub, PngFilter::Up, PngFilter::Average, PngFilter::Paeth}) {
+				if(auto cost = filterRow(type, row.data(), prior.data(), bytes, step, candidate.data()); cost < best) {
+					best = cost;
+					std::copy(candidate.begin(), candidate.end(), out);
+				}
+			}
+		}
+		else {
+			filterRow(filter, row.data(), prior.data(), bytes, step, out);
+		}
+		std::swap(prior, row);
+	}
+	return filtered;
+}
+
+struct Chunk
+{
+	std::vector<uint8_t> deflated;
+	uLong adler = 0;
+	size_t length = 0;
+};
+
+void checkZlib(int result) {
+	if(result == Z_MEM_ERROR) {
+		throw LeadToolsException(ERROR_NO_MEMORY);
+	}
+	if(result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+		throw std::runtime_error("zlib error " + std::to_string(result));
+	}
+}
+
+//Raw deflate of rows [first, last) that continues the stream of the rows before it.
+Chunk compressRows(RowReader& reader, int first, int last, bool final, const PngOptions& options, size_t step) {
+	trace::Span span("png_deflate");
+	const size_t lineBytes = reader.rowBytes() + 1;
+	std::vector<uint8_t> dictionary;
+	if(first > 0) {
+		//Filtering is deterministic, so the rows before are simply filtered again.
+		const int rows = static_cast<int>(std::min<size_t>(first, (windowBytes + lineBytes - 1) / lineBytes));
+		dictionary = filterRows(reader, first - rows, first, options.filter, step);
+		if(dictionary.size() > windowBytes) {
+			dictionary.erase(dictionary.begin(), dictionary.end() - windowBytes);
+		}
+	}
+	auto data = filterRows(reader, first, last, options.filter, step);
+
+	Chunk chunk;
+	chunk.length = data.size();
+	chunk.adler = adler32(adler32(0, Z_NULL, 0), data.data(), static_cast<uInt>(data.size()));
+
+	z_stream stream{};
+	checkZlib(deflateInit2(&stream, options.level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+	auto end = tc::makeUnique(&stream, deflateEnd);
+	if(!dictionary.empty()) {
+		checkZlib(deflateSetDictionary(&stream, dictionary.data(), static_cast<uInt>(dictionary.size())));
+	}
+	chunk.deflated.resize(deflateBound(&stream, data.size()) + 16);
+	stream.next_in = data.data();
+	stream.avail_in = static_cast<uInt>(data.size());
+	size_t produced = 0;
+	for(;;) {
+		stream.next_out = chunk.deflated.data() + produced;
+		stream.avail_out = static_cast<uInt>(chunk.deflated.size() - produced);
+		//A sync flush ends the chunk on a byte boundary without ending the stream.
+		const int result = deflate(&stream, final ? Z_FINISH : Z_SYNC_FLUSH);
+		checkZlib(result);
+		produced = chunk.deflated.size() - stream.avail_out;
+		if(final ? result == Z_STREAM_END : stream.avail_out != 0) {
+			break;
+		}
+		chunk.deflated.resize(chunk.deflated.size() * 2);
+	}
+	chunk.deflated.resize(produced);
+	return chunk;
+}
+
+void putUint32(uint8_t* out, uint32_t value) {
+	out[0] = static_cast<uint8_t>(value >> 24);
+	out[1] = static_cast<uint8_t>(value >> 16);
+	out[2] = static_cast<uint8_t>(value >> 8);
+	out[3] = static_cast<uint8_t>(value);
+}
+
+struct Bytes
+{
+	const void* data;
+	size_t size;
+};
+
+void writeChunk(std::ostream& out, const char* type, std::initializer_list<Bytes> parts) {
+	size_t length = 0;
+	for(const auto& part : parts) {
+		length += part.size;
+	}
+	uint8_t header[8];
+	putUint32(header, static_cast<uint32_t>(length));
+	std::copy(type, type + 4, header + 4);
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	uLong crc = crc32(0, header + 4, 4);
+	for(const auto& part : parts) {
+		out.write(static_cast<const char*>(part.data), static_cast<std::streamsize>(part.size));
+		crc = crc32(crc, static_cast<const Bytef*>(part.data), static_cast<uInt>(part.size));
+	}
+	uint8_t trailer[4];
+	putUint32(trailer, static_cast<uint32_t>(crc));
+	out.write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+}
+
+//Two byte zlib header announcing a 32K window and the compression level.
+std::pair<uint8_t, uint8_t> zlibHeader(int level) {
+	const unsigned method = 0x78;
+	const unsigned flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+	unsigned flags = flevel << 6;
+	flags += 31 - (method * 256 + flags) % 31;
+	return {static_cast<uint8_t>(method), static_cast<uint8_t>(flags)};
+}
+
+} //namespace
+
+PngFilter parsePngFilter(const std::string& name) {
+	if(name == "none") {
+		return PngFilter::None;
+	}
+	if(name == "sub") {
+		return PngFilter::Sub;
+	}
+	if(name == "up") {
+		return PngFilter::Up;
+	}
+	if(name == "average") {
+		return PngFilter::Average;
+	}
+	if(name == "paeth") {
+		return PngFilter::Paeth;
+	}
+	if(name == "adaptive") {
+		return PngFilter::Adaptive;
+	}
+	throw std::logic_error("Unknown PNG filter: " + name);
+}
+
+bool canWritePng(const BITMAPHANDLE& bitmap) {
+	Layout layout{};
+	return layoutOf(bitmap, layout) && bitmap.Width > 0 && bitmap.Height > 0;
+}
+
+void encodePng(BITMAPHANDLE& bitmap, std::ostream& out, const PngOptions& options, size_t threads) {
+	Layout layout{};
+	if(!layoutOf(bitmap, layout) || bitmap.Width <= 0 || bitmap.Height <= 0) {
+		throw LeadToolsException(ERROR_FEATURE_NOT_SUPPORTED);
+	}
+	if(bitmap.ViewPerspective != TOP_LEFT) {
+		call(L_ChangeBitmapViewPerspective, nullptr, &bitmap, sizeof(BITMAPHANDLE), TOP_LEFT);
+	}
+
+	RowReader reader(bitmap, layout);
+	const size_t lineBytes = reader.rowBytes() + 1;
+	const int rowsPerChunk = static_cast<int>(std::max<size_t>(1, chunkBytes / lineBytes));
+	const int chunkCount = (bitmap.Height + rowsPerChunk - 1) / rowsPerChunk;
+	std::vector<Chunk> chunks(chunkCount);
+	std::atomic<int> next{0};
+	std::atomic<bool> failed{false};
+	auto compress = [&] {
+		for(int i = next++; i < chunkCount && !failed; i = next++) {
+			try {
+				const int first = i * rowsPerChunk;
+				const int last = std::min(bitmap.Height, first + rowsPerChunk);
+				chunks[i] = compressRows(reader, first, last, i + 1 == chunkCount, options, layout.channels);
+			}
+			catch(...) {
+				failed = true;
+				throw;
+			}
+		}
+	};
+	runConcurrently(std::clamp<size_t>(threads, 1, chunkCount), compress);
+
+	uLong adler = adler32(0, Z_NULL, 0);
+	for(const auto& chunk : chunks) {
+		adler = adler32_combine(adler, chunk.adler, static_cast<z_off_t>(chunk.length));
+	}
+
+	static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	uint8_t header[13];
+	putUint32(header, static_cast<uint32_t>(bitmap.Width));
+	putUint32(header + 4, static_cast<uint32_t>(bitmap.Height));
+	header[8] = 8;
+	header[9] = layout.colorType;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	writeChunk(out, "IHDR", {{header, sizeof(header)}});
+
+	if(bitmap.XResolution > 0 && bitmap.YResolution > 0) {
+		//Dots per inch to pixels per meter.
+		uint8_t physical[9];
+		putUint32(physical, static_cast<uint32_t>(bitmap.XResolution / 0.0254 + 0.5));
+		putUint32(physical + 4, static_cast<uint32_t>(bitmap.YResolution / 0.0254 + 0.5));
+		physical[8] = 1;
+		writeChunk(out, "pHYs", {{physical, sizeof(physical)}});
+	}
+
+	if(layout.colorType == Indexed) {
+		std::vector<uint8_t> palette;
+		for(L_UINT i = 0; i < bitmap.nColors; ++i) {
+			const auto& color = bitmap.pPalette[i];
+			palette.insert(palette.end(), {color.rgbRed, color.rgbGreen, color.rgbBlue});
+		}
+		writeChunk(out, "PLTE", {{palette.data(), palette.size()}});
+	}
+
+	//One IDAT per chunk, the zlib header goes in front of the first and the checksum after the last.
+	const auto [method, flags] = zlibHeader(options.level);
+	const uint8_t zlibStart[] = {method, flags};
+	uint8_t zlibEnd[4];
+	putUint32(zlibEnd, static_cast<uint32_t>(adler));
+	for(int i = 0; i < chunkCount; ++i) {
+		const auto& deflated = chunks[i].deflated;
+		writeChunk(out, "IDAT", {
+			{zlibStart, i == 0 ? sizeof(zlibStart) : 0},
+			{deflated.data(), deflated.size()},
+			{zlibEnd, i + 1 == chunkCount ? sizeof(zlibEnd) : 0}
+		});
+	}
+	writeChunk(out, "IEND", {});
+}
+
+void writePng(BITMAPHANDLE& bitmap, const std::filesystem::path& output, const PngOptions& options, size_t threads) {
+	std::ofstream out(output, std::ios::binary | std::ios::trunc);
+	if(!out) {
+		//Not a LeadToolsException: ERROR_FILE_OPEN counts as transient and would be retried,
+		//a missing or read-only output directory fails the same way every time.
+		throw std::system_error(errno, std::generic_category(), "Cannot write " + output.string());
+	}
+	try {
+		encodePng(bitmap, out, options, threads);
+	}
+	catch(...) {
+		//Leaves no half written PNG behind for a later run to take as converted.
+		out.close();
+		std::error_code ec;
+		std::filesystem::remove(output, ec);
+		throw;
+	}
+	out.close();
+	if(!out) {
+		std::error_code ec;
+		std::filesystem::remove(output, ec);
+		throw LeadToolsException(ERROR_FILE_WRITE);
+	}
+}
+
+std::vector<uint8_t> encodePngMemory(BITMAPHANDLE& bitmap, const PngOptions& options, size_t threads) {
+	if(options.builtin && canWritePng(bitmap)) {
+		std::ostringstream out;
+		encodePng(bitmap, out, options, threads);
+		const auto bytes = std::move(out).str();
+		return std::vector<uint8_t>(bytes.begin(), bytes.end());
+	}
+	return saveBitmapMemory(bitmap, FILE_PNG, 0, 0);
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+//PNG row filter; Adaptive picks per row the one with the smallest sum of absolute
+//differences, like libpng does by default.
+enum class PngFilter
+{
+	None,
+	Sub,
+	Up,
+	Average,
+	Paeth,
+	Adaptive
+};
+
+struct PngOptions
+{
+	//Encode with writePng() instead of L_SaveBitmap(FILE_PNG).
+	bool builtin = false;
+	PngFilter filter = PngFilter::Adaptive;
+	//zlib level, 0-9.
+	int level = 6;
+};
+
+//Throws std::logic_error for unknown names.
+PngFilter parsePngFilter(const std::string& name);
+
+//Whether writePng() handles the layout of bitmap: 24-bit color and 8-bit gray or palette.
+bool canWritePng(const BITMAPHANDLE& bitmap);
+
+//Writes bitmap as a standard PNG. Rows are split into chunks that are filtered and deflated
+//on up to threads threads, each chunk primed with the 32K of data before it, and joined into
+//one zlib stream the way pigz does. May flip the bitmap to TOP_LEFT view perspective.
+void writePng(BITMAPHANDLE& bitmap, const std::filesystem::path& output, const PngOptions& options, size_t threads);
+
+//writePng() into a stream, e.g. to encode into memory.
+void encodePng(BITMAPHANDLE& bitmap, std::ostream& out, const PngOptions& options, size_t threads);
+
+//bitmap as a PNG file in memory, from the encoder options pick: the built-in one if asked for
+//and it handles the layout, the SDK's otherwise.
+std::vector<uint8_t> encodePngMemory(BITMAPHANDLE& bitmap, const PngOptions& options, size_t threads);
+
+} //namespace tc::ltool
@@ -0,0 +1,129 @@
+#include "prefetch.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+namespace
+{
+
+//Pulls file into the page cache; returns the bytes read.
+uint64_t warm(const std::filesystem::path& file, std::vector<char>& buffer) {
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		//The decoder reports it.
+		return 0;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	uint64_t total = 0;
+	for(;;) {
+		auto length = read(fd, buffer.data(), buffer.size());
+		if(length < 0 && errno == EINTR) {
+			continue;
+		}
+		if(length <= 0) {
+			break;
+		}
+		total += static_cast<uint64_t>(length);
+	}
+	close(fd);
+	return total;
+}
+
+} //namespace
+
+Prefetcher::Prefetcher(std::vector<std::filesystem::path> inputs, size_t depth, uint64_t budget, size_t threads)
+: m_inputs(std::move(inputs))
+, m_depth(depth ? depth : 1)
+, m_budget(budget)
+, m_sizes(m_inputs.size(), 0)
+, m_held(m_inputs.size(), 0)
+{
+	for(size_t i = 0; i < (threads ? threads : 1); ++i) {
+		m_threads.emplace_back([this] { run(); });
+	}
+}
+
+Prefetcher::~Prefetcher() {
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_room.notify_all();
+	for(auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void Prefetcher::started(size_t index) {
+	std::lock_guard lock(m_mutex);
+	//Jobs start in input order, so everything before index is under way as well.
+	if(m_next <= index) {
+		m_next = index + 1;
+	}
+}
+
+void Prefetcher::finished(size_t index) {
+	{
+		std::lock_guard lock(m_mutex);
+		if(m_held[index]) {
+			m_bytes -= m_held[index];
+			m_held[index] = 0;
+			--m_ahead;
+		}
+	}
+	m_room.notify_all();
+}
+
+void Prefetcher::run() {
+	std::vector<char> buffer(1 << 20);
+	auto& stats = Stats::get();
+	std::unique_lock lock(m_mutex);
+	for(;;) {
+		//Wakes up for an input not yet sized as well, to stat it.
+		m_room.wait(lock, [&] {
+			if(m_stopping || m_next >= m_inputs.size() || !m_sizes[m_next]) {
+				return true;
+			}
+			return m_ahead < m_depth && (m_ahead == 0 || m_bytes + m_sizes[m_next] <= m_budget);
+		});
+		if(m_stopping || m_next >= m_inputs.size()) {
+			return;
+		}
+		if(!m_sizes[m_next]) {
+			//A stat can take as long as a read on slow storage; decoders calling started() and
+			//finished() must not wait for it.
+			const size_t next = m_next;
+			lock.unlock();
+			std::error_code ec;
+			const auto known = std::filesystem::file_size(m_inputs[next], ec);
+			lock.lock();
+			//Counted as one byte when unknown, so it is held and released like the rest.
+			m_sizes[next] = ec || known == 0 ? 1 : known;
+			//m_next may have moved on meanwhile; look again.
+			continue;
+		}
+		const uint64_t size = m_sizes[m_next];
+		const size_t index = m_next++;
+		m_held[index] = size;
+		m_bytes += size;
+		++m_ahead;
+		lock.unlock();
+		{
+			trace::Span span("prefetch");
+			stats.prefetchedBytes.add(warm(m_inputs[index], buffer));
+		}
+		lock.lock();
+	}
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tc::ltool
+{
+
+//Reads the inputs of a batch ahead of the decoders so their L_FileInfo/L_LoadBitmap calls hit
+//the page cache instead of waiting on slow storage (NFS, FUSE mounts of object stores).
+//Stays at most depth files and budget bytes ahead of the files not yet done; a single file
+//larger than the budget is still read when nothing else is ahead. Each file is announced
+//with posix_fadvise(WILLNEED) and then read through, since FUSE and some network file
+//systems ignore the hint.
+class Prefetcher
+{
+public:
+	Prefetcher(std::vector<std::filesystem::path> inputs, size_t depth, uint64_t budget, size_t threads);
+
+	Prefetcher(const Prefetcher&) = delete;
+	Prefetcher& operator=(const Prefetcher&) = delete;
+
+	~Prefetcher();
+
+	//Input index has been picked up by a decoder; reading it ahead is pointless from now on.
+	void started(size_t index);
+
+	//Input index is converted, its bytes no longer count against the budget.
+	void finished(size_t index);
+
+private:
+	void run();
+
+	const std::vector<std::filesystem::path> m_inputs;
+	const size_t m_depth;
+	const uint64_t m_budget;
+	std::mutex m_mutex;
+	std::condition_variable m_room;
+	//Next input to read ahead.
+	size_t m_next = 0;
+	//File sizes, looked up as the prefetch gets to them; 0 until then.
+	std::vector<uint64_t> m_sizes;
+	//Bytes of inputs read ahead or being read and not finished.
+	std::vector<uint64_t> m_held;
+	size_t m_ahead = 0;
+	uint64_t m_bytes = 0;
+	bool m_stopping = false;
+	std::vector<std::thread> m_threads;
+};
+
+} //namespace tc::ltool
@@ -0,0 +1,115 @@
+#include "preview.h"
+
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "arena.h"
+#include "size_budget.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+class FrameWriter
+{
+public:
+	explicit FrameWriter(std::ostream& out)
+	: m_out(out)
+	{}
+
+	void write(const char* kind, const Encoded& frame, const char* type) {
+		const auto& bytes = frame.bytes;
+		m_out << kind << ' ' << frame.width << ' ' << frame.height << ' ' << type << ' ' << bytes.size() << '\n';
+		m_out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		m_out.flush();
+		Stats::get().bytesWritten.add(bytes.size());
+	}
+
+private:
+	std::ostream& m_out;
+};
+
+} //namespace
+
+void progressive(const std::filesystem::path& input, std::ostream& out, const ConvertOptions& options, const PreviewOptions& preview) {
+	if(options.svg || options.crop || options.container != Container::None) {
+		throw std::logic_error("Progressive output is a single raster page");
+	}
+	if(preview.page < 1) {
+		throw std::logic_error("Page numbers start at 1");
+	}
+	auto& stats = Stats::get();
+	//The preview is sized from the page shown, which need not be as large as the first.
+	const auto fileInfo = probe(input, options.rasterize, false, preview.page);
+	FrameWriter writer(out);
+	std::mutex mutex;
+	bool fullWritten = false;
+
+	auto full = std::async(std::launch::async, [&] {
+		JobArena::Scope scratch;
+		trace::FileScope traceFile(input);
+		//The SDK may write to the file info, this thread gets its own.
+		auto info = fileInfo;
+		uint64_t decodedBytes = 0;
+		auto bitmap = renderPage(input, info, preview.page, options, decodedBytes);
+		Encoded frame;
+		{
+			metrics::ScopedTimer timer(stats.saveSeconds);
+			trace::Span span("encode", preview.page);
+			if(options.maxBytes) {
+				frame = fitPng(*bitmap.get(), options.maxBytes, options.png, options.pageThreads);
+			}
+			else {
+				frame = {encodePngMemory(*bitmap.get(), options.png, options.pageThreads), bitmap->Width, bitmap->Height};
+			}
+		}
+		std::lock_guard lock(mutex);
+		writer.write("full", frame, "image/png");
+		fullWritten = true;
+		stats.pages.add();
+	});
+
+	try {
+		JobArena::Scope scratch;
+		const double scale = std::min(1.0, static_cast<double>(preview.size) / std::max({fileInfo.Width, fileInfo.Height, 1}));
+		const int width = std::max(1, static_cast<int>(fileInfo.Width * scale + 0.5));
+		const int height = std::max(1, static_cast<int>(fileInfo.Height * scale + 0.5));
+		auto info = fileInfo;
+		Bitmap bitmap;
+		LOADFILEOPTION loadOpt{};
+		call(L_GetDefaultLoadFileOption, &loadOpt, sizeof(LOADFILEOPTION));
+		loadOpt.PageNumber = preview.page;
+		options.rasterize.fittedInto(width, height).apply(input);
+		{
+			trace::Span span("load_page_resized", preview.page);
+			//Documents are rasterized at preview size, JPEG can skip detail by DCT scaling.
+			call(L_LoadBitmapResize, tc::scratchPath(input).get(), bitmap.get(), sizeof(BITMAPHANDLE),
+				width, height, 24, SIZE_RESAMPLE, ORDER_BGR, &loadOpt, &info);
+		}
+		Encoded frame;
+		{
+			trace::Span span("encode_preview", preview.page);
+			frame = {saveBitmapMemory(*bitmap.get(), FILE_JPEG, 24, preview.quality), bitmap->Width, bitmap->Height};
+		}
+		std::lock_guard lock(mutex);
+		if(!fullWritten) {
+			writer.write("preview", frame, "image/jpeg");
+		}
+	}
+	catch(const LeadToolsException&) {
+		//Nothing lost but time to first pixel; if the page itself cannot be read, the full
+		//render reports why.
+	}
+	full.get();
+}
+
+} //namespace tc::ltool
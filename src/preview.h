@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <ostream>
+
+#include "convert.h"
+
+namespace tc::ltool
+{
+
+struct PreviewOptions
+{
+	//Longest side of the preview in pixels.
+	int size = 256;
+	//JPEG QFactor of the preview, 2 (best) to 255 (smallest).
+	int quality = 50;
+	//1-based.
+	int page = 1;
+};
+
+//Streams page of input to out as up to two frames, for viewers that should show something
+//before the page is fully rendered: first a JPEG preview decoded straight at preview.size,
+//the way thumbnails are, then the page as convert() renders it, as PNG. A frame is a header
+//line "<kind> <width> <height> <mime type> <length>\n" followed by length bytes, kind being
+//"preview" or "full"; out is flushed after each.
+//The full page is rendered alongside the preview, not after it, so it is not delayed by it.
+//The preview is the page as decoded, before options.pipeline, and is skipped if it would come
+//second or fails. Not for svg, crop or container options.
+void progressive(const std::filesystem::path& input, std::ostream& out, const ConvertOptions& options, const PreviewOptions& preview);
+
+} //namespace tc::ltool
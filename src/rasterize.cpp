@@ -0,0 +1,134 @@
+#include "rasterize.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+
+#include "leadtools.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+int parsePositive(const std::string& text, const std::string& option) {
+	size_t end = 0;
+	int value = 0;
+	try {
+		value = std::stoi(text, &end);
+	}
+	catch(const std::exception&) {
+		end = 0;
+	}
+	if(end == 0 || end != text.size() || value <= 0) {
+		throw std::logic_error("Invalid value for --" + option + ": " + text);
+	}
+	return value;
+}
+
+std::string lower(std::string text) {
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return text;
+}
+
+//Extension of input without the dot, lower case.
+std::string formatOf(const std::filesystem::path& input) {
+	auto extension = input.extension().string();
+	return lower(extension.empty() ? extension : extension.substr(1));
+}
+
+} //namespace
+
+RasterizePolicy RasterizePolicy::parse(const std::string& dpi, const std::string& pageSize) {
+	RasterizePolicy policy;
+	std::istringstream stream(dpi);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		if(item.empty()) {
+			continue;
+		}
+		const auto eq = item.find('=');
+		if(eq == std::string::npos) {
+			policy.m_dpi = parsePositive(item, "dpi");
+			continue;
+		}
+		auto format = item.substr(0, eq);
+		if(!format.empty() && format[0] == '.') {
+			format.erase(0, 1);
+		}
+		if(format.empty()) {
+			throw std::logic_error("Invalid value for --dpi: " + item);
+		}
+		policy.m_formatDpi[lower(format)] = parsePositive(item.substr(eq + 1), "dpi");
+	}
+	if(!pageSize.empty()) {
+		const auto x = pageSize.find('x');
+		if(x == std::string::npos) {
+			throw std::logic_error("Invalid value for --page-size: " + pageSize);
+		}
+		policy.m_pageWidth = parsePositive(pageSize.substr(0, x), "page-size");
+		policy.m_pageHeight = parsePositive(pageSize.substr(x + 1), "page-size");
+	}
+	return policy;
+}
+
+int RasterizePolicy::dpiFor(const std::filesystem::path& input) const {
+	if(auto it = m_formatDpi.find(formatOf(input)); it != m_formatDpi.end()) {
+		return it->second;
+	}
+	return m_dpi;
+}
+
+std::string RasterizePolicy::spec() const {
+	std::ostringstream text;
+	text << m_dpi;
+	for(const auto& [format, dpi] : m_formatDpi) {
+		text << ',' << format << '=' << dpi;
+	}
+	if(m_pageWidth) {
+		text << ';' << m_pageWidth << 'x' << m_pageHeight;
+	}
+	return text.str();
+}
+
+void RasterizePolicy::apply(const std::filesystem::path& input) const {
+	//The SDK hands out the thread's current options, which are whatever the last file loaded
+	//on it set. Read once, before the first set, every call starts over from the defaults.
+	static const RASTERIZEDOCUMENTLOADOPTIONS defaults = [] {
+		RASTERIZEDOCUMENTLOADOPTIONS options{};
+		call(L_GetRasterizeDocumentOptions, &options, sizeof(RASTERIZEDOCUMENTLOADOPTIONS));
+		return options;
+	}();
+	auto options = defaults;
+	const int dpi = dpiFor(input);
+	if(dpi) {
+		options.XResolution = dpi;
+		options.YResolution = dpi;
+	}
+	if(m_pageWidth) {
+		options.Unit = RASTERIZEDOCUMENT_UNIT_PIXEL;
+		options.PageWidth = m_pageWidth;
+		options.PageHeight = m_pageHeight;
+		options.SizeMode = RASTERIZEDOCUMENT_SIZEMODE_FIT;
+	}
+	else if(dpi) {
+		//The document's own page size at the chosen resolution.
+		options.SizeMode = RASTERIZEDOCUMENT_SIZEMODE_NONE;
+	}
+	call(L_SetRasterizeDocumentOptions, &options);
+}
+
+RasterizePolicy RasterizePolicy::fittedInto(int width, int height) const {
+	auto policy = *this;
+	if(!policy.m_pageWidth) {
+		policy.m_pageWidth = width;
+		policy.m_pageHeight = height;
+	}
+	return policy;
+}
+
+} //namespace tc::ltool
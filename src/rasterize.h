@@ -0,0 +1,48 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+
+namespace tc::ltool
+{
+
+//Resolution and page size PDF, Office and other document pages are rasterized at, so they
+//are rendered at the size the output needs instead of the SDK default and shrunk afterwards.
+//Render time and memory scale with the pixels produced. Raster inputs are not affected.
+//Built from a DPI spec such as "150,pdf=200,pptx=96" (a default plus per-extension
+//overrides) and a page size WIDTHxHEIGHT in pixels the page is fitted into, aspect ratio kept.
+class RasterizePolicy
+{
+public:
+	//Throws std::logic_error for bad values. Either spec may be empty.
+	static RasterizePolicy parse(const std::string& dpi, const std::string& pageSize);
+
+	//Nothing set, the SDK defaults apply.
+	bool empty() const {
+		return !m_dpi && m_formatDpi.empty() && !m_pageWidth;
+	}
+
+	//DPI for input, 0 for the SDK default.
+	int dpiFor(const std::filesystem::path& input) const;
+
+	//Settings as text, for optionsFingerprint().
+	std::string spec() const;
+
+	//Sets the SDK's rasterize options for input before it is probed or loaded. The SDK keeps
+	//them per thread, so this is done on the thread that loads. Whatever the policy leaves
+	//unset is back at the SDK default, also when it is empty().
+	void apply(const std::filesystem::path& input) const;
+
+	//Same policy, pages fitted into width x height pixels unless a page size is set already.
+	RasterizePolicy fittedInto(int width, int height) const;
+
+private:
+	int m_dpi = 0;
+	//Keyed by lower case extension without the dot.
+	std::map<std::string, int> m_formatDpi;
+	int m_pageWidth = 0;
+	int m_pageHeight = 0;
+};
+
+} //namespace tc::ltool
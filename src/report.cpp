@@ -0,0 +1,45 @@
+#include "report.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "json.h"
+
+namespace tc::ltool
+{
+
+Report::Report()
+: m_out(&std::cout)
+{}
+
+Report::Report(const std::filesystem::path& path)
+: m_file(path, std::ios::app)
+, m_out(&m_file)
+{
+	if(!m_file) {
+		throw std::runtime_error("Cannot open report " + path.string());
+	}
+}
+
+void Report::record(const PageResult& result) {
+	//Formatted outside the lock, written in one piece.
+	std::ostringstream line;
+	line << "{\"input\":";
+	tc::writeJsonString(line, result.input.string());
+	line << ",\"page\":" << result.page << ",\"output\":";
+	tc::writeJsonString(line, result.output.string());
+	if(result.hash) {
+		line << ",\"phash\":\"" << std::hex << std::setw(16) << std::setfill('0') << *result.hash << std::dec << '"';
+	}
+	if(result.duplicateOf) {
+		line << ",\"duplicate_of\":";
+		tc::writeJsonString(line, result.duplicateOf->string());
+	}
+	line << "}\n";
+	std::lock_guard lock(m_mutex);
+	*m_out << line.str() << std::flush;
+}
+
+} //namespace tc::ltool
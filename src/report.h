@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+
+namespace tc::ltool
+{
+
+//What happened to one page of a conversion.
+struct PageResult
+{
+	std::filesystem::path input;
+	int page = 1;
+	//Empty when the page was not written.
+	std::filesystem::path output;
+	std::optional<uint64_t> hash;
+	//Earlier output the page was found to be a near duplicate of.
+	std::optional<std::filesystem::path> duplicateOf;
+};
+
+//Result report: one JSON object per line and page, written as pages finish, e.g.
+//{"input":"a.pdf","page":2,"output":"out/a-2.png","phash":"f0e4c2d9b3a18c07"}
+class Report
+{
+public:
+	//Writes to stdout.
+	Report();
+	explicit Report(const std::filesystem::path& path);
+
+	//Thread safe; lines are flushed so the report can be followed while a run is going.
+	void record(const PageResult& result);
+
+private:
+	std::mutex m_mutex;
+	std::ofstream m_file;
+	std::ostream* m_out;
+};
+
+} //namespace tc::ltool
@@ -0,0 +1,160 @@
+#include "size_budget.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <ltkrn.h>
+
+#include "trace.h"
+
+namespace tc::ltool
+{
+
+using namespace tc::leadtools;
+
+namespace
+{
+
+//A candidate within 5% of the limit is as good as the best one there is.
+constexpr double closeEnough = 0.95;
+
+Encoded encoded(std::vector<uint8_t> bytes, const BITMAPHANDLE& bitmap) {
+	return {std::move(bytes), bitmap.Width, bitmap.Height};
+}
+
+void reduceToPalette(BITMAPHANDLE& bitmap) {
+	call(L_ColorResBitmap, &bitmap, &bitmap, sizeof(BITMAPHANDLE), 8, CRF_OPTIMIZEDPALETTE, nullptr, nullptr, 0, nullptr, nullptr);
+}
+
+[[noreturn]] void doesNotFit(uint64_t maxBytes) {
+	throw std::runtime_error("Output does not fit in " + std::to_string(maxBytes) + " bytes");
+}
+
+//The largest copy of bitmap shrunk by a scale below 1 that encode() gets within maxBytes,
+//knowing that at full scale it took fullSize bytes.
+template<typename Encode>
+Encoded shrinkToFit(const BITMAPHANDLE& bitmap, uint64_t maxBytes, size_t fullSize, Encode encode) {
+	trace::Span span("shrink_to_fit");
+	constexpr int maxEncodes = 8;
+	double fits = 0;
+	double tooLarge = 1;
+	double scale = 1;
+	size_t size = fullSize;
+	Encoded best;
+	for(int i = 0; i < maxEncodes && tooLarge - fits > 0.01; ++i) {
+		//Aim a little below the limit: the model is rough, a miss costs another encode.
+		double guess = scale * std::sqrt(0.97 * maxBytes / std::max<size_t>(size, 1));
+		if(guess <= fits || guess >= tooLarge) {
+			guess = (fits + tooLarge) / 2;
+		}
+		const int width = std::max(1, static_cast<int>(std::lround(bitmap.Width * guess)));
+		const int height = std::max(1, static_cast<int>(std::lround(bitmap.Height * guess)));
+		Bitmap candidate;
+		call(L_CopyBitmap, candidate.get(), const_cast<BITMAPHANDLE*>(&bitmap), sizeof(BITMAPHANDLE));
+		call(L_SizeBitmap, candidate.get(), width, height, SIZE_RESAMPLE);
+		auto bytes = encode(*candidate.get());
+		scale = guess;
+		size = bytes.size();
+		if(size <= maxBytes) {
+			fits = guess;
+			best = encoded(std::move(bytes), *candidate.get());
+			if(size >= closeEnough * maxBytes) {
+				break;
+			}
+		}
+		else {
+			tooLarge = guess;
+			if(width == 1 && height == 1) {
+				break;
+			}
+		}
+	}
+	if(best.bytes.empty()) {
+		doesNotFit(maxBytes);
+	}
+	return best;
+}
+
+} //namespace
+
+Encoded fitPng(BITMAPHANDLE& bitmap, uint64_t maxBytes, const PngOptions& options, size_t threads) {
+	trace::Span span("fit_png");
+	auto bytes = encodePngMemory(bitmap, options, threads);
+	if(bytes.size() <= maxBytes) {
+		return encoded(std::move(bytes), bitmap);
+	}
+	bool palette = false;
+	if(bitmap.BitsPerPixel > 8) {
+		Bitmap reduced;
+		call(L_CopyBitmap, reduced.get(), &bitmap, sizeof(BITMAPHANDLE));
+		reduceToPalette(*reduced.get());
+		bytes = encodePngMemory(*reduced.get(), options, threads);
+		if(bytes.size() <= maxBytes) {
+			return encoded(std::move(bytes), *reduced.get());
+		}
+		palette = true;
+	}
+	//Shrunk from the full color page, the palette is picked for the pixels that are left.
+	return shrinkToFit(bitmap, maxBytes, bytes.size(), [&](BITMAPHANDLE& candidate) {
+		if(palette) {
+			reduceToPalette(candidate);
+		}
+		return encodePngMemory(candidate, options, threads);
+	});
+}
+
+Encoded fitJpeg(BITMAPHANDLE& bitmap, uint64_t maxBytes, int bitsPerPixel, int quality) {
+	trace::Span span("fit_jpeg");
+	constexpr int worstQuality = 255;
+	quality = std::clamp(quality, 2, worstQuality);
+	auto bytes = saveBitmapMemory(bitmap, FILE_JPEG, bitsPerPixel, quality);
+	if(bytes.size() <= maxBytes) {
+		return encoded(std::move(bytes), bitmap);
+	}
+	//Size falls as the QFactor rises; look for the lowest one that fits.
+	int tooLarge = quality;
+	int fits = worstQuality + 1;
+	std::vector<uint8_t> best;
+	while(fits - tooLarge > 1) {
+		const int middle = (tooLarge + fits) / 2;
+		bytes = saveBitmapMemory(bitmap, FILE_JPEG, bitsPerPixel, middle);
+		if(bytes.size() <= maxBytes) {
+			fits = middle;
+			best = std::move(bytes);
+			if(best.size() >= closeEnough * maxBytes) {
+				break;
+			}
+		}
+		else {
+			tooLarge = middle;
+		}
+	}
+	if(!best.empty()) {
+		return encoded(std::move(best), bitmap);
+	}
+	return shrinkToFit(bitmap, maxBytes, bytes.size(), [&](BITMAPHANDLE& candidate) {
+		return saveBitmapMemory(candidate, FILE_JPEG, bitsPerPixel, worstQuality);
+	});
+}
+
+void writeFile(const std::filesystem::path& output, const std::vector<uint8_t>& bytes) {
+	std::ofstream out(output, std::ios::binary | std::ios::trunc);
+	if(!out) {
+		//Not retried, as in writePng().
+		throw std::system_error(errno, std::generic_category(), "Cannot write " + output.string());
+	}
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	out.close();
+	if(!out) {
+		std::error_code ec;
+		std::filesystem::remove(output, ec);
+		throw LeadToolsException(ERROR_FILE_WRITE);
+	}
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "leadtools.h"
+#include "png_writer.h"
+
+namespace tc::ltool
+{
+
+//Byte limits on output, met from the one decoded bitmap: candidates are encoded into memory
+//and the best one that fits is kept, the page is never decoded again.
+
+//An encoded candidate and the size of the page it holds.
+struct Encoded
+{
+	std::vector<uint8_t> bytes;
+	int width = 0;
+	int height = 0;
+};
+
+//Largest PNG of bitmap within maxBytes. Tries the bitmap as it is, then, above 8 bits per pixel,
+//reduced to an optimized 8-bit palette, then shrunk until it fits. Each scale tried comes from
+//PNG size growing with the pixel count: the last candidate's scale, corrected by the square root
+//of how far off its size was, so a few encodes do. Throws std::runtime_error when not even a
+//thumbnail of the page fits.
+Encoded fitPng(BITMAPHANDLE& bitmap, uint64_t maxBytes, const PngOptions& options, size_t threads);
+
+//JPEG of bitmap within maxBytes at the best QFactor from quality up that fits, by bisection;
+//shrunk like fitPng() at QFactor 255 when even that is too large.
+Encoded fitJpeg(BITMAPHANDLE& bitmap, uint64_t maxBytes, int bitsPerPixel, int quality);
+
+//Writes bytes to output, replacing it.
+void writeFile(const std::filesystem::path& output, const std::vector<uint8_t>& bytes);
+
+} //namespace tc::ltool
@@ -0,0 +1,60 @@
+#include "stats.h"
+
+#include <string>
+
+#include "kernels.h"
+
+namespace tc::ltool
+{
+
+namespace
+{
+
+metrics::Histogram& stageHistogram(const char* stage) {
+	return metrics::Registry::global().histogram(
+		"ltool_stage_seconds", "Latency of LEADTOOLS calls per conversion stage.",
+		{0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30},
+		std::string("stage=\"") + stage + "\""
+	);
+}
+
+} //namespace
+
+Stats& Stats::get() {
+	auto& registry = metrics::Registry::global();
+	static Stats stats{
+		registry.counter("ltool_jobs_total", "Finished conversion jobs.", "result=\"success\""),
+		registry.counter("ltool_jobs_total", "Finished conversion jobs.", "result=\"failure\""),
+		registry.counter("ltool_pages_total", "Pages written."),
+		registry.counter("ltool_read_bytes_total", "Size of converted inputs."),
+		registry.counter("ltool_written_bytes_total", "Size of written outputs."),
+		registry.counter("ltool_retries_total", "Job attempts repeated after a transient failure."),
+		stageHistogram("file_info"),
+		stageHistogram("load"),
+		stageHistogram("transform"),
+		stageHistogram("save"),
+		registry.gauge("ltool_queue_depth", "Jobs waiting for a worker."),
+		registry.gauge("ltool_workers_busy", "Workers currently converting."),
+		registry.gauge("ltool_workers", "Worker threads in the pool."),
+		registry.gauge("ltool_admitted_bytes", "Estimated memory of the jobs being converted."),
+		registry.gauge("ltool_memory_budget_bytes", "Memory the admission controller currently allows."),
+		registry.counter("ltool_duplicate_pages_total", "Pages not written as near duplicates of earlier output."),
+		registry.counter("ltool_preemptions_total", "Jobs run inline between the pages of a less urgent job."),
+		registry.counter("ltool_prefetched_bytes_total", "Input bytes read ahead of the decoders."),
+	};
+	static bool described = [&] {
+		registry.gauge("ltool_kernels_info", "Instruction set the pixel kernels dispatched to.", std::string("isa=\"") + kernels::isa() + "\"").set(1);
+		return true;
+	}();
+	(void)described;
+	return stats;
+}
+
+void Stats::recordError(int code, const char* category) {
+	metrics::Registry::global().counter(
+		"ltool_errors_total", "Failed LEADTOOLS calls by error code.",
+		"code=\"" + std::to_string(code) + "\",category=\"" + category + "\""
+	).add();
+}
+
+} //namespace tc::ltool
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "metrics.h"
+
+namespace tc::ltool
+{
+
+//Metrics of the conversion pipeline, registered in metrics::Registry::global().
+struct Stats
+{
+	metrics::Counter& jobsSucceeded;
+	metrics::Counter& jobsFailed;
+	metrics::Counter& pages;
+	metrics::Counter& bytesRead;
+	metrics::Counter& bytesWritten;
+	metrics::Counter& retries;
+	metrics::Histogram& fileInfoSeconds;
+	metrics::Histogram& loadSeconds;
+	metrics::Histogram& transformSeconds;
+	metrics::Histogram& saveSeconds;
+	metrics::Gauge& queueDepth;
+	metrics::Gauge& workersBusy;
+	metrics::Gauge& workers;
+	metrics::Gauge& memoryAdmitted;
+	metrics::Gauge& memoryBudget;
+	metrics::Counter& duplicatePages;
+	metrics::Counter& preemptions;
+	metrics::Counter& prefetchedBytes;
+
+	static Stats& get();
+
+	//Counts a failure by its LEADTOOLS error code; takes the registry lock, so error paths only.
+	void recordError(int code, const char* category);
+};
+
+} //namespace tc::ltool
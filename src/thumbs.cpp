@@ -0,0 +1,161 @@
+#include "thumbs.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "arena.h"
+#include "convert.h"
+#include "json.h"
+#include "leadtools.h"
+#include "size_budget.h"
+#include "stats.h"
+#include "trace.h"
+#include "worker_pool.h"
+
+namespace tc::ltool
+{
+
+using namespace std::filesystem;
+using namespace tc::leadtools;
+
+namespace
+{
+
+struct Thumbnail
+{
+	path source;
+	path output;
+	int width = 0;
+	int height = 0;
+	int sourceWidth = 0;
+	int sourceHeight = 0;
+	std::optional<int> pages;
+	std::string error;
+};
+
+void makeThumbnail(Thumbnail& thumbnail, const ThumbsOptions& options) {
+	auto& stats = Stats::get();
+	JobArena::Scope scratch;
+	trace::FileScope traceFile(thumbnail.source);
+	trace::Span span("thumbnail");
+	auto fileInfo = probe(thumbnail.source, options.rasterize, options.countPages);
+	thumbnail.sourceWidth = fileInfo.Width;
+	thumbnail.sourceHeight = fileInfo.Height;
+	if(options.countPages) {
+		thumbnail.pages = fileInfo.TotalPages;
+	}
+	const double scale = std::min(1.0, static_cast<double>(options.size) / std::max({fileInfo.Width, fileInfo.Height, 1}));
+	const int width = std::max(1, static_cast<int>(fileInfo.Width * scale + 0.5));
+	const int height = std::max(1, static_cast<int>(fileInfo.Height * scale + 0.5));
+
+	Bitmap bitmap;
+	LOADFILEOPTION loadOpt{};
+	call(L_GetDefaultLoadFileOption, &loadOpt, sizeof(LOADFILEOPTION));
+	loadOpt.PageNumber = 1;
+	options.rasterize.fittedInto(width, height).apply(thumbnail.source);
+	{
+		metrics::ScopedTimer timer(stats.loadSeconds);
+		trace::Span loadSpan("load_page_resized", 1);
+		//Lets the decoder skip detail it would throw away, e.g. JPEG DCT scaling.
+		call(L_LoadBitmapResize, tc::scratchPath(thumbnail.source).get(), bitmap.get(), sizeof(BITMAPHANDLE),
+			width, height, 24, SIZE_RESAMPLE, ORDER_BGR, &loadOpt, &fileInfo);
+	}
+	{
+		metrics::ScopedTimer timer(stats.saveSeconds);
+		trace::Span saveSpan("encode_write", 1);
+		if(options.maxBytes) {
+			auto fitted = fitJpeg(*bitmap.get(), options.maxBytes, 24, options.quality);
+			writeFile(thumbnail.output, fitted.bytes);
+			thumbnail.width = fitted.width;
+			thumbnail.height = fitted.height;
+		}
+		else {
+			call(L_SaveBitmap, tc::scratchPath(thumbnail.output).get(), bitmap.get(), FILE_JPEG, 24, options.quality, nullptr);
+			thumbnail.width = bitmap->Width;
+			thumbnail.height = bitmap->Height;
+		}
+	}
+	stats.pages.add();
+	std::error_code ec;
+	if(auto size = file_size(thumbnail.output, ec); !ec) {
+		stats.bytesWritten.add(size);
+	}
+}
+
+void writeManifest(const path& file, const std::vector<Thumbnail>& thumbnails) {
+	std::ofstream out(file);
+	if(!out) {
+		throw std::system_error(errno, std::generic_category(), "Cannot write " + file.string());
+	}
+	out << "[\n";
+	for(size_t i = 0; i < thumbnails.size(); ++i) {
+		const auto& thumbnail = thumbnails[i];
+		out << "  {\"source\": ";
+		tc::writeJsonString(out, thumbnail.source.filename().string());
+		if(thumbnail.error.empty()) {
+			out << ", \"thumbnail\": ";
+			tc::writeJsonString(out, thumbnail.output.filename().string());
+			out << ", \"width\": " << thumbnail.width << ", \"height\": " << thumbnail.height
+				<< ", \"sourceWidth\": " << thumbnail.sourceWidth << ", \"sourceHeight\": " << thumbnail.sourceHeight;
+			if(thumbnail.pages) {
+				out << ", \"pages\": " << *thumbnail.pages;
+			}
+		}
+		else {
+			out << ", \"error\": ";
+			tc::writeJsonString(out, thumbnail.error);
+		}
+		out << (i + 1 < thumbnails.size() ? "},\n" : "}\n");
+	}
+	out << "]\n";
+}
+
+} //namespace
+
+size_t thumbs(const path& dir, const ThumbsOptions& options) {
+	create_directories(options.outDir);
+	std::vector<Thumbnail> thumbnails;
+	for(const auto& entry : directory_iterator(dir)) {
+		auto name = entry.path().filename().string();
+		if(entry.is_regular_file() && name.front() != '.') {
+			Thumbnail thumbnail;
+			thumbnail.source = entry.path();
+			//The source extension is kept, so a.png and a.pdf do not collide.
+			thumbnail.output = options.outDir / (name + ".jpg");
+			thumbnails.push_back(std::move(thumbnail));
+		}
+	}
+	std::sort(thumbnails.begin(), thumbnails.end(), [](const auto& l, const auto& r) { return l.source < r.source; });
+
+	{
+		WorkerPool pool(options.threads, options.threads * 4);
+		//Every task owns its element, the vector itself is not resized while they run.
+		for(auto& thumbnail : thumbnails) {
+			pool.submit([&thumbnail, &options] {
+				try {
+					makeThumbnail(thumbnail, options);
+					Stats::get().jobsSucceeded.add();
+				}
+				catch(const LeadToolsException& e) {
+					Stats::get().recordError(e.code(), toString(e.category()));
+					Stats::get().jobsFailed.add();
+					thumbnail.error = e.what();
+				}
+				catch(const std::exception& e) {
+					Stats::get().jobsFailed.add();
+					thumbnail.error = e.what();
+				}
+			});
+		}
+		pool.wait();
+	}
+	writeManifest(options.outDir / "manifest.json", thumbnails);
+	return std::count_if(thumbnails.begin(), thumbnails.end(), [](const auto& t) { return !t.error.empty(); });
+}
+
+} //namespace tc::ltool
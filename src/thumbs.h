@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "rasterize.h"
+
+namespace tc::ltool
+{
+
+struct ThumbsOptions
+{
+	size_t threads = 1;
+	//Longest side of a thumbnail in pixels.
+	int size = 128;
+	//JPEG QFactor, 2 (best) to 255 (smallest).
+	int quality = 30;
+	//Largest thumbnail written, 0 for no limit: the QFactor is raised from quality, and the
+	//thumbnail shrunk at the worst, until it fits. See fitJpeg().
+	uint64_t maxBytes = 0;
+	std::filesystem::path outDir;
+	//Without a page size here, document pages are rasterized straight at thumbnail size.
+	RasterizePolicy rasterize;
+	//Whether manifest.json has the page count of every file. Counting can take a pass over the
+	//whole file, where the thumbnail itself only needs the first page.
+	bool countPages = false;
+};
+
+//Writes a JPEG thumbnail of the first page of every file in dir to options.outDir, plus
+//manifest.json describing all of them. Pages are decoded straight at thumbnail size; page
+//counts are only in the manifest with options.countPages.
+//Returns the number of files that failed.
+size_t thumbs(const std::filesystem::path& dir, const ThumbsOptions& options);
+
+} //namespace tc::ltool
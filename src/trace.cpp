@@ -0,0 +1,147 @@
+#include "trace.h"
+
+#include <cerrno>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "json.h"
+
+namespace tc::trace
+{
+
+namespace detail
+{
+
+std::atomic<bool> g_enabled{false};
+
+} //namespace detail
+
+namespace
+{
+
+//A thread stops recording past this many events instead of growing without bound.
+constexpr size_t maxEventsPerThread = 1 << 20;
+
+struct Event
+{
+	const char* name;
+	int64_t begin;
+	int64_t end;
+	int64_t page;
+	uint32_t file;
+};
+
+struct ThreadBuffer
+{
+	long tid;
+	std::vector<Event> events;
+	size_t dropped = 0;
+};
+
+const auto g_origin = std::chrono::steady_clock::now();
+
+std::mutex g_mutex;
+//Buffers outlive their threads, so spans of finished workers are still written.
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+//Index 0 is "no file".
+std::vector<std::string> g_files{""};
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+thread_local uint32_t t_file = 0;
+
+ThreadBuffer& threadBuffer() {
+	if(!t_buffer) {
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->tid = syscall(SYS_gettid);
+		buffer->events.reserve(1024);
+		std::lock_guard lock(g_mutex);
+		t_buffer = g_buffers.emplace_back(std::move(buffer)).get();
+	}
+	return *t_buffer;
+}
+
+} //namespace
+
+namespace detail
+{
+
+int64_t nowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_origin).count();
+}
+
+void record(const char* name, int64_t begin, int64_t end, int64_t page) {
+	auto& buffer = threadBuffer();
+	if(buffer.events.size() == maxEventsPerThread) {
+		++buffer.dropped;
+		return;
+	}
+	buffer.events.push_back({name, begin, end, page, t_file});
+}
+
+} //namespace detail
+
+void enable() {
+	detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+FileScope::FileScope(const std::filesystem::path& file)
+: m_previous(t_file)
+{
+	if(enabled()) {
+		std::lock_guard lock(g_mutex);
+		t_file = static_cast<uint32_t>(g_files.size());
+		g_files.push_back(file.string());
+	}
+}
+
+FileScope::~FileScope() {
+	t_file = m_previous;
+}
+
+void write(const std::filesystem::path& file) {
+	std::ofstream out(file);
+	if(!out) {
+		throw std::system_error(errno, std::generic_category(), "Cannot write trace " + file.string());
+	}
+	std::lock_guard lock(g_mutex);
+	const auto pid = getpid();
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto separator = [&] {
+		out << (first ? "" : ",\n");
+		first = false;
+	};
+	for(const auto& buffer : g_buffers) {
+		separator();
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+			<< ",\"args\":{\"name\":\"" << (buffer->tid == pid ? "main" : "worker") << "\"}}";
+		for(const auto& event : buffer->events) {
+			separator();
+			out << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+				<< ",\"ts\":" << event.begin << ",\"dur\":" << event.end - event.begin << ",\"args\":{";
+			if(event.file) {
+				out << "\"file\":";
+				tc::writeJsonString(out, g_files[event.file]);
+			}
+			if(event.page >= 0) {
+				out << (event.file ? "," : "") << "\"page\":" << event.page;
+			}
+			out << "}}";
+		}
+		if(buffer->dropped) {
+			separator();
+			out << "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"dropped " << buffer->dropped << " events\",\"pid\":" << pid
+				<< ",\"tid\":" << buffer->tid << ",\"ts\":" << buffer->events.back().end << "}";
+		}
+	}
+	out << "\n]}\n";
+}
+
+} //namespace tc::trace
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+namespace tc::trace
+{
+
+namespace detail
+{
+
+extern std::atomic<bool> g_enabled;
+
+int64_t nowMicros();
+void record(const char* name, int64_t begin, int64_t end, int64_t page);
+
+} //namespace detail
+
+//Starts recording spans. Until then a Span costs one relaxed load.
+void enable();
+
+inline bool enabled() {
+	return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+//Writes everything recorded so far in the Chrome trace event format (chrome://tracing, Perfetto).
+//Recording threads must be finished or idle.
+void write(const std::filesystem::path& file);
+
+//Tags the spans recorded by this thread during its lifetime with file.
+class FileScope
+{
+public:
+	explicit FileScope(const std::filesystem::path& file);
+	FileScope(const FileScope&) = delete;
+	FileScope& operator=(const FileScope&) = delete;
+	~FileScope();
+
+private:
+	uint32_t m_previous;
+};
+
+//Records a complete event from construction to destruction into a per-thread buffer.
+//name must outlive the trace, i.e. be a literal.
+class Span
+{
+public:
+	explicit Span(const char* name, int64_t page = -1)
+	: m_name(enabled() ? name : nullptr), m_page(page), m_begin(m_name ? detail::nowMicros() : 0)
+	{}
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+	~Span() {
+		if(m_name) {
+			detail::record(m_name, m_begin, detail::nowMicros(), m_page);
+		}
+	}
+
+private:
+	const char* m_name;
+	int64_t m_page;
+	int64_t m_begin;
+};
+
+} //namespace tc::trace
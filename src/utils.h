@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace tc
+{
+
+template<typename T, typename D>
+auto makeUnique(T&& t, D&& d) {
+	return std::unique_ptr<std::remove_pointer_t<std::remove_reference_t<T>>, std::decay_t<D>>(
+		std::forward<T>(t),
+		std::forward<D>(d)
+	);
+}
+
+template<typename TCode, typename BaseException = std::runtime_error>
+class ExceptionWithErrorCode : public BaseException
+{
+public:
+	using Code = TCode;
+
+	template<typename... BaseArgs>
+	ExceptionWithErrorCode(Code code, BaseArgs&&... args)
+	: BaseException(std::forward<BaseArgs>(args)...), m_code(code)
+	{}
+
+	const Code& code() const {
+		return m_code;
+	}
+
+protected:
+	using ExceptionWithErrorCode_ = ExceptionWithErrorCode;
+	Code m_code;
+};
+
+template<typename R, typename IndirectPointer>
+auto makeDirectDeleter(R(*deleter)(IndirectPointer)) {
+	return [deleter](std::remove_pointer_t<IndirectPointer> data) {
+		deleter(&data);
+	};
+}
+
+inline std::unique_ptr<char[]> strdup(const char* s) {
+	assert(s);
+	auto size = std::strlen(s);
+	auto dupped = std::make_unique<char[]>(size + 1);
+	std::copy(s, s + size, dupped.get());
+	dupped[size] = 0;
+	return dupped;
+}
+
+} //namespace tc
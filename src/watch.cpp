@@ -0,0 +1,304 @@
+#include "watch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <map>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "fair_queue.h"
+#include "job.h"
+#include "metrics.h"
+#include "stats.h"
+
+namespace tc::ltool
+{
+
+namespace
+{
+
+using namespace std::filesystem;
+
+//Lock-free, so also safe to set from the signal handler.
+std::atomic<bool> g_stopRequested{false};
+
+void requestStop(int) {
+	g_stopRequested = true;
+}
+
+void installStopHandlers() {
+	struct sigaction action{};
+	action.sa_handler = requestStop;
+	sigemptyset(&action.sa_mask);
+	//No SA_RESTART: poll() has to return with EINTR to notice the request.
+	action.sa_flags = 0;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+}
+
+class FileDescriptor
+{
+public:
+	explicit FileDescriptor(int fd) : m_fd(fd) {
+		if(m_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "inotify_init1");
+		}
+	}
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+	~FileDescriptor() {
+		close(m_fd);
+	}
+	int get() const {
+		return m_fd;
+	}
+
+private:
+	int m_fd;
+};
+
+bool isSpoolFile(const path& file) {
+	auto name = file.filename().string();
+	return !name.empty() && name.front() != '.';
+}
+
+//"acme@scan.pdf" belongs to tenant acme, names without '@' to the unnamed tenant.
+std::string tenantOf(const path& file) {
+	auto name = file.filename().string();
+	auto at = name.find('@');
+	return at == std::string::npos ? std::string() : name.substr(0, at);
+}
+
+//Priority of the job this worker thread is converting, unset on other threads.
+thread_local std::optional<Priority> t_running;
+
+class Spool
+{
+public:
+	Spool(const path& inDir, const path& outDir, const WatchOptions& options)
+	: m_inDir(inDir), m_outDir(outDir), m_doneDir(inDir / "done"), m_failedDir(inDir / "failed"),
+	  m_capacity(options.queueCapacity), m_settings{options.convert, options.policy}
+	{
+		if(options.maxMemory) {
+			m_settings.admission = &m_admission.emplace(options.maxMemory);
+		}
+		m_settings.convert.preemptionPoint = [this] { preempt(); };
+		//A preempting job runs on the thread of the job it interrupted, which holds its admission
+		//ticket until it resumes: waiting for admission there could wait on itself forever.
+		m_preemptingSettings = m_settings;
+		m_preemptingSettings.admission = nullptr;
+		const auto threads = std::max<size_t>(options.threads, 1);
+		//The queue stays one: priorities and tenant turns are decided across all workers.
+		const auto slots = options.affinity ? placeWorkers(threads) : std::vector<CpuSlot>(threads);
+		for(size_t i = 0; i < threads; ++i) {
+			m_workers.emplace_back([this, slot = slots[i]] {
+				pinCurrentThread(slot);
+				work();
+			});
+		}
+		Stats::get().workers.set(threads);
+	}
+
+	Spool(const Spool&) = delete;
+	Spool& operator=(const Spool&) = delete;
+
+	//Lets running jobs finish; queued files stay in the spool for the next start.
+	~Spool() {
+		m_queue.close();
+		for(auto& worker : m_workers) {
+			worker.join();
+		}
+		//The dropped jobs were counted when enqueued; with the workers gone nothing pops them.
+		Stats::get().queueDepth.add(-static_cast<int64_t>(m_queue.size()));
+	}
+
+	//Never blocks, so a file for a more urgent class is always seen right away. With the
+	//queue full, normal and low priority files stay on disk until resweep() picks them up.
+	void enqueue(const path& file, Priority priority) {
+		if(!isSpoolFile(file)) {
+			return;
+		}
+		{
+			std::lock_guard lock(m_mutex);
+			//The startup sweep and an event can both report the same file.
+			if(m_pending.count(file)) {
+				return;
+			}
+			if(priority != Priority::High && m_queue.size() >= m_capacity) {
+				m_backlog = true;
+				return;
+			}
+			m_pending.insert(file);
+		}
+		Stats::get().queueDepth.add();
+		m_queue.push(priority, tenantOf(file), Job{file, priority});
+	}
+
+	void sweep(const path& dir, Priority priority) {
+		for(const auto& entry : directory_iterator(dir)) {
+			if(entry.is_regular_file()) {
+				enqueue(entry.path(), priority);
+			}
+		}
+	}
+
+	//Whether files were left on disk and the queue has drained enough to take them.
+	bool resweepDue() {
+		std::lock_guard lock(m_mutex);
+		if(!m_backlog || m_queue.size() > m_capacity / 2) {
+			return false;
+		}
+		m_backlog = false;
+		return true;
+	}
+
+private:
+	struct Job
+	{
+		path file;
+		Priority priority;
+	};
+
+	void work() {
+		auto& stats = Stats::get();
+		while(auto job = m_queue.pop()) {
+			stats.workersBusy.add();
+			process(*job, m_settings);
+			stats.workersBusy.add(-1);
+		}
+	}
+
+	//Preemption point between pages: a strictly more urgent job runs now on this thread,
+	//the interrupted one continues after it.
+	void preempt() {
+		if(!t_running) {
+			return;
+		}
+		while(auto job = m_queue.popMoreUrgentThan(*t_running)) {
+			Stats::get().preemptions.add();
+			process(*job, m_preemptingSettings);
+		}
+	}
+
+	void process(const Job& job, const JobSettings& settings) {
+		const auto& file = job.file;
+		Stats::get().queueDepth.add(-1);
+		auto interrupted = std::exchange(t_running, job.priority);
+		std::error_code ec;
+		if(is_regular_file(file, ec)) {
+			auto status = runJob(file, outputPathFor(file, m_outDir, settings.convert), settings);
+			if(status == JobStatus::Aborted) {
+				std::cerr << "Stopping: the error above would fail every following job" << std::endl;
+				g_stopRequested = true;
+			}
+			rename(file, (status == JobStatus::Succeeded ? m_doneDir : m_failedDir) / file.filename(), ec);
+			if(ec) {
+				std::cerr << file.string() << ": " << ec.message() << std::endl;
+			}
+		}
+		t_running = interrupted;
+		std::lock_guard lock(m_mutex);
+		m_pending.erase(file);
+	}
+
+	const path m_inDir;
+	const path m_outDir;
+	const path m_doneDir;
+	const path m_failedDir;
+	const size_t m_capacity;
+	std::optional<AdmissionController> m_admission;
+	JobSettings m_settings;
+	//m_settings without admission, for jobs run inside preempt().
+	JobSettings m_preemptingSettings;
+	std::mutex m_mutex;
+	//Queued and running files; bounded by queue capacity plus thread count and the high
+	//priority files, so memory stays flat however long we run.
+	std::set<path> m_pending;
+	bool m_backlog = false;
+	FairQueue<Job> m_queue;
+	std::vector<std::thread> m_workers;
+};
+
+} //namespace
+
+void watch(const path& inDir, const path& outDir, const WatchOptions& options) {
+	create_directories(outDir);
+	create_directories(inDir / "done");
+	create_directories(inDir / "failed");
+
+	FileDescriptor inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+	//Files dropped straight into inDir are normal priority, inDir/high and inDir/low pick the class.
+	std::map<int, std::pair<path, Priority>> spoolDirs;
+	for(const auto& [dir, priority] : {std::pair{inDir, Priority::Normal}, {inDir / "high", Priority::High}, {inDir / "low", Priority::Low}}) {
+		create_directories(dir);
+		auto wd = inotify_add_watch(inotify.get(), dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+		if(wd < 0) {
+			throw std::system_error(errno, std::generic_category(), "inotify_add_watch " + dir.string());
+		}
+		spoolDirs[wd] = {dir, priority};
+	}
+	installStopHandlers();
+
+	std::optional<metrics::Server> metricsServer;
+	if(options.metricsPort) {
+		metricsServer.emplace(options.metricsPort);
+	}
+	Spool spool(inDir, outDir, options);
+	auto sweep = [&] {
+		for(const auto& [wd, dir] : spoolDirs) {
+			spool.sweep(dir.first, dir.second);
+		}
+	};
+	//After the watches are armed, so nothing dropped in between is missed.
+	sweep();
+
+	alignas(inotify_event) char buffer[4096];
+	while(!g_stopRequested) {
+		pollfd pfd{inotify.get(), POLLIN, 0};
+		//Bounded wait: a worker may request the stop without a signal.
+		if(poll(&pfd, 1, 500) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "poll");
+		}
+		if(spool.resweepDue()) {
+			sweep();
+		}
+		for(;;) {
+			auto length = read(inotify.get(), buffer, sizeof(buffer));
+			if(length < 0) {
+				if(errno == EAGAIN || errno == EINTR) {
+					break;
+				}
+				throw std::system_error(errno, std::generic_category(), "read inotify");
+			}
+			for(char* p = buffer; p < buffer + length;) {
+				const auto* event = reinterpret_cast<const inotify_event*>(p);
+				p += sizeof(inotify_event) + event->len;
+				if(event->mask & IN_Q_OVERFLOW) {
+					sweep();
+				}
+				else if(auto dir = spoolDirs.find(event->wd); dir != spoolDirs.end() && event->len && !(event->mask & IN_ISDIR)) {
+					spool.enqueue(dir->second.first / event->name, dir->second.second);
+				}
+			}
+		}
+	}
+}
+
+} //namespace tc::ltool
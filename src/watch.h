@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "job.h"
+
+namespace tc::ltool
+{
+
+struct WatchOptions
+{
+	size_t threads = 1;
+	//Normal and low priority jobs waiting for a worker; when full, new files stay in the spool
+	//and are swept in once the queue has drained to half.
+	size_t queueCapacity = 16;
+	//Serves the metrics registry on 127.0.0.1 when non-zero.
+	uint16_t metricsPort = 0;
+	ConvertOptions convert;
+	ErrorPolicy policy;
+	//Estimated memory of the jobs converted at once; 0 admits on thread count alone.
+	uint64_t maxMemory = 0;
+	//Pins workers to cores across the NUMA nodes.
+	bool affinity = false;
+};
+
+//Converts every file that appears in inDir into outDir until SIGINT or SIGTERM.
+//Files are picked up once closed after writing or moved in, so writers can drop files
+//directly or rename them in atomically. Names starting with '.' are ignored, which leaves
+//room for in-progress temporaries. Converted inputs are moved to inDir/done, failed ones
+//to inDir/failed. An error that would fail every job (see ErrorPolicy) stops the watch.
+//Files dropped into inDir/high or inDir/low instead of inDir run at that priority; a name
+//prefix "TENANT@" assigns the file to a tenant. Workers take the most urgent class first and
+//let tenants of a class take turns. A multi-page job runs more urgent waiting jobs between
+//its pages, so a preview does not wait for a whole archive.
+void watch(const std::filesystem::path& inDir, const std::filesystem::path& outDir, const WatchOptions& options);
+
+} //namespace tc::ltool
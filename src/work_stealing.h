@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tc
+{
+
+//Worker threads with a deque each. Tasks submitted from outside go through a bounded queue,
+//submit() blocking while it is full like WorkerPool. Tasks spawned by a running task (a
+//Group) go to its worker's deque: the worker takes its newest task, idle workers steal the
+//oldest ones. A document split into page tasks is thus spread over every idle worker.
+//Workers may be grouped into shards, e.g. one per NUMA node: submitted tasks are dealt out to
+//the shards in turn, and workers look for work in their own shard before stealing elsewhere.
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void()>;
+
+	//Tasks spawned together; wait() helps running queued tasks until all of them are done.
+	class Group
+	{
+	public:
+		explicit Group(WorkStealingPool& pool)
+		: m_pool(pool)
+		{}
+
+		Group(const Group&) = delete;
+		Group& operator=(const Group&) = delete;
+
+		~Group() {
+			try {
+				wait();
+			}
+			catch(...) {
+			}
+		}
+
+		void run(Task task) {
+			++m_pending;
+			m_pool.push([this, task = std::move(task)] {
+				try {
+					task();
+				}
+				catch(...) {
+					std::lock_guard lock(m_mutex);
+					if(!m_error) {
+						m_error = std::current_exception();
+					}
+				}
+				//Under the lock: wait() takes it before returning, so the group cannot be destroyed
+				//while this task still touches it.
+				std::lock_guard lock(m_mutex);
+				if(--m_pending == 0) {
+					m_done.notify_all();
+				}
+			});
+		}
+
+		//Rethrows the first exception of the group's tasks.
+		void wait() {
+			while(m_pending > 0) {
+				Task task;
+				if(m_pool.takeQueued(task)) {
+					m_pool.execute(task);
+					continue;
+				}
+				//Whatever is left runs on other workers.
+				std::unique_lock lock(m_mutex);
+				m_done.wait(lock, [this] { return m_pending == 0; });
+			}
+			std::lock_guard lock(m_mutex);
+			if(m_error) {
+				std::rethrow_exception(std::exchange(m_error, nullptr));
+			}
+		}
+
+	private:
+		WorkStealingPool& m_pool;
+		std::atomic<size_t> m_pending{0};
+		std::mutex m_mutex;
+		std::condition_variable m_done;
+		std::exception_ptr m_error;
+	};
+
+	WorkStealingPool(size_t threads, size_t capacity)
+	: WorkStealingPool(std::vector<size_t>(threads ? threads : 1, 0), capacity)
+	{}
+
+	//One worker per entry of shards, the entry being its shard. init runs first thing on
+	//every worker thread with the worker's index, e.g. to pin it.
+	WorkStealingPool(const std::vector<size_t>& shards, size_t capacity, std::function<void(size_t)> init = {})
+	: m_capacity(capacity ? capacity : 1)
+	, m_workers(shards.empty() ? 1 : shards.size())
+	{
+		size_t shardCount = 1;
+		for(size_t i = 0; i < shards.size(); ++i) {
+			m_workers[i].shard = shards[i];
+			shardCount = std::max(shardCount, shards[i] + 1);
+		}
+		m_injected.resize(shardCount);
+		//Workers of the same shard first, the rest after.
+		for(size_t i = 0; i < m_workers.size(); ++i) {
+			auto& order = m_stealOrder.emplace_back();
+			for(size_t j = 0; j < m_workers.size(); ++j) {
+				order.push_back((i + j) % m_workers.size());
+			}
+			std::stable_partition(order.begin(), order.end(), [&](size_t worker) {
+				return m_workers[worker].shard == m_workers[i].shard;
+			});
+		}
+		m_threads.reserve(m_workers.size());
+		for(size_t i = 0; i < m_workers.size(); ++i) {
+			m_threads.emplace_back([this, i, init] {
+				if(init) {
+					init(i);
+				}
+				run(i);
+			});
+		}
+	}
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	~WorkStealingPool() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for(auto& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	//Called from one of the pool's own tasks it never blocks, the task goes to its worker's deque.
+	void submit(Task task) {
+		if(t_current.pool == this) {
+			push(std::move(task));
+			return;
+		}
+		++m_pending;
+		std::unique_lock lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_injectedCount < m_capacity; });
+		++m_queued;
+		inject(std::move(task));
+		lock.unlock();
+		m_wake.notify_one();
+	}
+
+	//Queues task without ever blocking, past the bound if need be; for callers that must not
+	//wait, such as an event loop thread.
+	void post(Task task) {
+		push(std::move(task));
+	}
+
+	//Blocks until every submitted task has finished.
+	void wait() {
+		std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_pending == 0; });
+	}
+
+	size_t threadCount() const {
+		return m_threads.size();
+	}
+
+	//Pool the calling thread works for, if any.
+	static WorkStealingPool* current() {
+		return t_current.pool;
+	}
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		size_t shard = 0;
+	};
+
+	struct Current
+	{
+		WorkStealingPool* pool;
+		size_t index;
+	};
+
+	//Onto the calling worker's deque; from other threads onto the shared queue, past its bound
+	//since the caller may be waiting for the task.
+	void push(Task task) {
+		++m_pending;
+		++m_queued;
+		if(t_current.pool == this) {
+			auto& worker = m_workers[t_current.index];
+			std::lock_guard lock(worker.mutex);
+			worker.tasks.push_back(std::move(task));
+		}
+		else {
+			std::lock_guard lock(m_mutex);
+			inject(std::move(task));
+		}
+		//Taking the lock orders the push before a worker's check of m_queued.
+		{
+			std::lock_guard lock(m_mutex);
+		}
+		m_wake.notify_one();
+	}
+
+	//Onto the next shard's queue; expects m_mutex to be held.
+	void inject(Task task) {
+		m_injected[m_nextShard].push_back(std::move(task));
+		m_nextShard = (m_nextShard + 1) % m_injected.size();
+		++m_injectedCount;
+	}
+
+	//Own deque from the back, then the others' from the front, own shard first.
+	bool takeQueued(Task& task) {
+		const size_t self = t_current.pool == this ? t_current.index : 0;
+		for(size_t i = 0; i < m_workers.size(); ++i) {
+			auto& worker = m_workers[m_stealOrder[self][i]];
+			std::lock_guard lock(worker.mutex);
+			if(worker.tasks.empty()) {
+				continue;
+			}
+			const bool own = i == 0 && t_current.pool == this;
+			task = std::move(own ? worker.tasks.back() : worker.tasks.front());
+			own ? worker.tasks.pop_back() : worker.tasks.pop_front();
+			--m_queued;
+			return true;
+		}
+		return false;
+	}
+
+	bool takeInjected(Task& task) {
+		std::unique_lock lock(m_mutex);
+		if(m_injectedCount == 0) {
+			return false;
+		}
+		const size_t own = t_current.pool == this ? m_workers[t_current.index].shard : 0;
+		for(size_t i = 0; i < m_injected.size(); ++i) {
+			auto& queue = m_injected[(own + i) % m_injected.size()];
+			if(!queue.empty()) {
+				task = std::move(queue.front());
+				queue.pop_front();
+				break;
+			}
+		}
+		--m_injectedCount;
+		--m_queued;
+		lock.unlock();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void execute(Task& task) {
+		task();
+		task = nullptr;
+		if(--m_pending == 0) {
+			std::lock_guard lock(m_mutex);
+			m_idle.notify_all();
+		}
+	}
+
+	void run(size_t index) {
+		t_current = {this, index};
+		for(;;) {
+			Task task;
+			//Spawned work first: it belongs to jobs already started.
+			if(takeQueued(task) || takeInjected(task)) {
+				execute(task);
+				continue;
+			}
+			std::unique_lock lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stopping || m_queued > 0; });
+			if(m_stopping && m_queued == 0) {
+				return;
+			}
+		}
+	}
+
+	inline static thread_local Current t_current{};
+
+	const size_t m_capacity;
+	std::vector<Worker> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_notFull;
+	std::condition_variable m_idle;
+	//Per shard.
+	std::vector<std::deque<Task>> m_injected;
+	size_t m_injectedCount = 0;
+	size_t m_nextShard = 0;
+	std::vector<std::vector<size_t>> m_stealOrder;
+	std::atomic<size_t> m_pending{0};
+	std::atomic<size_t> m_queued{0};
+	bool m_stopping = false;
+	std::vector<std::thread> m_threads;
+};
+
+//Runs body on up to threads threads at once, the calling one included. On a worker of a
+//WorkStealingPool the extra copies are tasks idle workers steal, elsewhere they get threads
+//of their own. Rethrows the first exception once every copy has returned.
+inline void runConcurrently(size_t threads, const std::function<void()>& body) {
+	if(auto* pool = WorkStealingPool::current()) {
+		WorkStealingPool::Group group(*pool);
+		for(size_t i = 1; i < threads; ++i) {
+			group.run(body);
+		}
+		body();
+		group.wait();
+		return;
+	}
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto guarded = [&] {
+		try {
+			body();
+		}
+		catch(...) {
+			std::lock_guard lock(errorMutex);
+			if(!error) {
+				error = std::current_exception();
+			}
+		}
+	};
+	std::vector<std::thread> helpers;
+	for(size_t i = 1; i < threads; ++i) {
+		helpers.emplace_back(guarded);
+	}
+	guarded();
+	for(auto& helper : helpers) {
+		helper.join();
+	}
+	if(error) {
+		std::rethrow_exception(error);
+	}
+}
+
+} //namespace tc
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tc
+{
+
+//Fixed set of threads fed from a bounded queue. submit() blocks while the queue is full,
+//so a fast producer is throttled to the conversion rate instead of growing memory.
+class WorkerPool
+{
+public:
+	using Task = std::function<void()>;
+
+	WorkerPool(size_t threads, size_t capacity)
+	: m_capacity(capacity ? capacity : 1)
+	{
+		if(threads == 0) {
+			threads = 1;
+		}
+		m_threads.reserve(threads);
+		for(size_t i = 0; i < threads; ++i) {
+			m_threads.emplace_back([this] { run(); });
+		}
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	~WorkerPool() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_notEmpty.notify_all();
+		for(auto& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	void submit(Task task) {
+		std::unique_lock lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_queue.size() < m_capacity; });
+		m_queue.push_back(std::move(task));
+		lock.unlock();
+		m_notEmpty.notify_one();
+	}
+
+	//Blocks until every submitted task has finished.
+	void wait() {
+		std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_queue.empty() && m_active == 0; });
+	}
+
+	size_t threadCount() const {
+		return m_threads.size();
+	}
+
+private:
+	void run() {
+		for(;;) {
+			std::unique_lock lock(m_mutex);
+			m_notEmpty.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if(m_queue.empty()) {
+				return;
+			}
+			Task task = std::move(m_queue.front());
+			m_queue.pop_front();
+			++m_active;
+			lock.unlock();
+			m_notFull.notify_one();
+
+			task();
+
+			lock.lock();
+			if(--m_active == 0 && m_queue.empty()) {
+				m_idle.notify_all();
+			}
+		}
+	}
+
+	const size_t m_capacity;
+	std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+	std::condition_variable m_idle;
+	std::deque<Task> m_queue;
+	size_t m_active = 0;
+	bool m_stopping = false;
+	std::vector<std::thread> m_threads;
+};
+
+} //namespace tc
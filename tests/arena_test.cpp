@@ -0,0 +1,156 @@
+//Counts global operator new calls to show that, once the per-thread JobArena has grown to fit,
+//the job path takes nothing from the heap: first the arena itself, then whole runJob() calls
+//converting a sample. Allocations the SDK makes with malloc are not counted.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <ltool/ltool.h>
+
+#include "arena.h"
+#include "job.h"
+
+namespace
+{
+
+std::atomic<size_t> g_allocations{0};
+
+void* allocate(size_t size, size_t alignment) {
+	++g_allocations;
+	void* p = alignment > alignof(std::max_align_t)
+		? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+		: std::malloc(size ? size : 1);
+	if(!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+} //namespace
+
+void* operator new(size_t size) {
+	return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size) {
+	return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+namespace
+{
+
+int failures = 0;
+
+void expect(bool ok, const char* what) {
+	if(!ok) {
+		std::fprintf(stderr, "FAIL %s\n", what);
+		++failures;
+	}
+}
+
+//Allocations f() makes on its repeat run, after warmup runs let the arena grow.
+template<typename F>
+size_t steadyAllocations(F f, int warmup = 3, int repeat = 50) {
+	for(int i = 0; i < warmup; ++i) {
+		f();
+	}
+	const size_t before = g_allocations;
+	for(int i = 0; i < repeat; ++i) {
+		f();
+	}
+	return g_allocations - before;
+}
+
+void testArena() {
+	const std::filesystem::path input = "/spool/in/some rather long directory name/scan-000123.pdf";
+	//Scratch of the shape jobs take: path copies, nested scopes of page tasks, and more than
+	//the initial buffer, so the arena has to grow once.
+	auto job = [&] {
+		tc::JobArena::Scope scratch;
+		auto path = tc::scratchPath(input);
+		for(int page = 0; page < 8; ++page) {
+			tc::JobArena::Scope pageScratch;
+			auto copy = tc::scratchCopy(path.get());
+			std::pmr::vector<char> buffer(8 << 10, 0, tc::JobArena::resource());
+		}
+	};
+	expect(steadyAllocations(job) == 0, "arena: steady state job scratch allocates");
+	const size_t before = g_allocations;
+	{
+		auto outside = tc::scratchCopy("outside of any scope");
+	}
+	expect(g_allocations - before == 1, "arena: scratch outside a scope comes from the heap");
+}
+
+void testJob(const std::filesystem::path& sample) {
+	tc::ltool::initialize(LICENSE_FILE, DEVELOPER_KEY);
+	const auto output = std::filesystem::temp_directory_path() / "ltool_arena_test.png";
+	const tc::ltool::JobSettings settings;
+	bool succeeded = true;
+	const auto allocations = steadyAllocations([&] {
+		succeeded &= tc::ltool::runJob(sample, output, settings) == tc::ltool::JobStatus::Succeeded;
+	});
+	std::error_code ec;
+	std::filesystem::remove(output, ec);
+	expect(succeeded, "runJob: sample did not convert");
+	if(allocations) {
+		std::fprintf(stderr, "runJob: %zu allocations in 50 jobs\n", allocations);
+	}
+	expect(allocations == 0, "runJob: steady state jobs allocate");
+}
+
+} //namespace
+
+int main(int argc, char** argv) {
+	testArena();
+	if(argc > 1) {
+		testJob(argv[1]);
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+//Times every kernel on every instruction set the CPU runs, on rows of an A4 page at 300 DPI.
+//  kernels_bench [ROWS]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "kernels.h"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t width = 2480;
+
+//Megapixels per second of run() over rows rows.
+template<typename F>
+double measure(size_t rows, F run) {
+	const auto start = Clock::now();
+	for(size_t row = 0; row < rows; ++row) {
+		run();
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return rows * width / seconds / 1e6;
+}
+
+} //namespace
+
+int main(int argc, char** argv) {
+	using namespace tc::kernels;
+	const size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	std::vector<uint8_t> source(4 * 2 * width);
+	for(size_t i = 0; i < source.size(); ++i) {
+		source[i] = static_cast<uint8_t>(i * 7 + i / 3);
+	}
+	auto pixels = source;
+	std::vector<uint8_t> out(4 * width);
+	//Output pixels of the downscale: the two source rows hold twice as many.
+	const size_t half = width / 2;
+	std::printf("%-8s %12s %12s %12s %12s %12s\n", "isa", "swapRB", "bgrToGray", "down2x/1", "down2x/3", "down2x/4");
+	for(const auto& kernels : supported()) {
+		std::printf("%-8s", kernels.isa);
+		std::printf(" %12.0f", measure(rows, [&] { kernels.swapRedBlue(pixels.data(), width); }));
+		std::printf(" %12.0f", measure(rows, [&] { kernels.bgrToGray(source.data(), out.data(), width); }));
+		for(int channels : {1, 3, 4}) {
+			const uint8_t* row1 = source.data() + 2 * half * channels;
+			std::printf(" %12.0f", measure(rows, [&] { kernels.boxDownscale2x(source.data(), row1, out.data(), half, channels); }));
+		}
+		std::printf("   Mpx/s\n");
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+//Checks every instruction set the CPU runs against the scalar kernels, on widths around the
+//vector steps so every main loop and every tail is hit.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "kernels.h"
+
+namespace
+{
+
+using namespace tc::kernels;
+
+//Bytes past the end of every output that no kernel may touch.
+constexpr size_t guard = 64;
+constexpr uint8_t guardByte = 0xA5;
+
+std::vector<size_t> widths() {
+	std::vector<size_t> result;
+	for(size_t width = 0; width <= 130; ++width) {
+		result.push_back(width);
+	}
+	for(size_t width : {255, 256, 257, 1000, 1023, 4097}) {
+		result.push_back(width);
+	}
+	return result;
+}
+
+std::vector<uint8_t> randomBytes(std::mt19937& random, size_t size) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::vector<uint8_t> bytes(size);
+	for(auto& value : bytes) {
+		value = static_cast<uint8_t>(byte(random));
+	}
+	return bytes;
+}
+
+int failures = 0;
+
+void check(bool ok, const char* isa, const char* kernel, size_t width, int channels = 0) {
+	if(!ok) {
+		std::fprintf(stderr, "FAIL %s %s width=%zu channels=%d\n", isa, kernel, width, channels);
+		++failures;
+	}
+}
+
+void testSwapRedBlue(const Kernels& kernels, std::mt19937& random) {
+	for(size_t width : widths()) {
+		auto expected = randomBytes(random, 3 * width);
+		auto actual = expected;
+		actual.resize(actual.size() + guard, guardByte);
+		scalar::swapRedBlue(expected.data(), width);
+		kernels.swapRedBlue(actual.data(), width);
+		expected.resize(expected.size() + guard, guardByte);
+		check(actual == expected, kernels.isa, "swapRedBlue", width);
+	}
+}
+
+void testBgrToGray(const Kernels& kernels, std::mt19937& random) {
+	for(size_t width : widths()) {
+		const auto bgr = randomBytes(random, 3 * width);
+		std::vector<uint8_t> expected(width + guard, guardByte);
+		std::vector<uint8_t> actual(width + guard, guardByte);
+		scalar::bgrToGray(bgr.data(), expected.data(), width);
+		kernels.bgrToGray(bgr.data(), actual.data(), width);
+		check(actual == expected, kernels.isa, "bgrToGray", width);
+	}
+}
+
+void testBoxDownscale2x(const Kernels& kernels, std::mt19937& random) {
+	for(int channels : {1, 2, 3, 4}) {
+		for(size_t width : widths()) {
+			const size_t rowBytes = 2 * width * channels;
+			const auto row0 = randomBytes(random, rowBytes);
+			const auto row1 = randomBytes(random, rowBytes);
+			std::vector<uint8_t> expected(width * channels + guard, guardByte);
+			std::vector<uint8_t> actual(width * channels + guard, guardByte);
+			scalar::boxDownscale2x(row0.data(), row1.data(), expected.data(), width, channels);
+			kernels.boxDownscale2x(row0.data(), row1.data(), actual.data(), width, channels);
+			check(actual == expected, kernels.isa, "boxDownscale2x", width, channels);
+		}
+	}
+}
+
+} //namespace
+
+int main() {
+	std::mt19937 random(42);
+	for(const auto& kernels : supported()) {
+		testSwapRedBlue(kernels, random);
+		testBgrToGray(kernels, random);
+		testBoxDownscale2x(kernels, random);
+		std::printf("%s checked\n", kernels.isa);
+	}
+	return failures ? 1 : 0;
+}